@@ -0,0 +1,59 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include "common.h"
+
+namespace tpm {
+
+// Source of tensor buffers, see Tensor::setAllocator
+class TensorAllocator {
+  public:
+    virtual ~TensorAllocator() {}
+    virtual VType *alloc(size_t size) = 0;
+    virtual void release(VType *ptr) = 0;
+    // release many buffers at once, e.g. all the tensors of a graph
+    virtual void release(const std::vector<VType *> &ptrs) {
+        for (auto ptr : ptrs)
+            release(ptr);
+    }
+};
+
+// Stack allocator for the scratch tensors of a search. Buffers are sized
+// from the tensor shapes and handed out in chunks, so growing the arena
+// never moves live buffers. Buffers are expected to be released roughly in
+// LIFO order; a buffer released below the top is reclaimed once everything
+// above it is released.
+class TensorArena : public TensorAllocator {
+    struct Block {
+        size_t chunk, offset, size;
+        bool released;
+    };
+    size_t chunkSize;
+    std::vector<std::unique_ptr<VType[]>> chunks;
+    std::vector<size_t> chunkSizes;
+    std::vector<Block> blocks;
+    // top of the stack
+    size_t curChunk, curOffset;
+    size_t used, peak;
+
+  public:
+    TensorArena(size_t chunkSize = 16 * 1024 * 1024)
+        : chunkSize(chunkSize), curChunk(0), curOffset(0), used(0), peak(0) {}
+    TensorArena(const TensorArena &) = delete;
+    TensorArena &operator=(const TensorArena &) = delete;
+
+    VType *alloc(size_t size) override;
+    void release(VType *ptr) override;
+    using TensorAllocator::release;
+
+    // number of elements in live buffers
+    size_t getUsed() const { return used; }
+    size_t getPeak() const { return peak; }
+    void resetPeak() { peak = used; }
+    // number of elements held by the chunks
+    size_t getCapacity() const;
+};
+
+} // end of namespace tpm
+
+#endif // ARENA_H
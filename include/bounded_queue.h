@@ -0,0 +1,55 @@
+#ifndef BOUNDED_QUEUE_H
+#define BOUNDED_QUEUE_H
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+namespace tpm {
+
+// Blocking FIFO with a fixed capacity, used to connect pipeline stages.
+// push blocks while full; pop blocks while empty until close() is called.
+template <class T> class BoundedQueue {
+    std::deque<T> items;
+    size_t capacity;
+    bool closed;
+    std::mutex mtx;
+    std::condition_variable notFull, notEmpty;
+
+  public:
+    BoundedQueue(size_t capacity) : capacity(capacity), closed(false) {}
+
+    // return false if the queue is closed
+    bool push(const T &item) {
+        std::unique_lock<std::mutex> lock(mtx);
+        notFull.wait(lock, [&] { return closed || items.size() < capacity; });
+        if (closed)
+            return false;
+        items.emplace_back(item);
+        notEmpty.notify_one();
+        return true;
+    }
+
+    // return false if the queue is closed and drained
+    bool pop(T &item) {
+        std::unique_lock<std::mutex> lock(mtx);
+        notEmpty.wait(lock, [&] { return closed || !items.empty(); });
+        if (items.empty())
+            return false;
+        item = items.front();
+        items.pop_front();
+        notFull.notify_one();
+        return true;
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> lock(mtx);
+        closed = true;
+        notFull.notify_all();
+        notEmpty.notify_all();
+    }
+};
+
+} // end of namespace tpm
+
+#endif // BOUNDED_QUEUE_H
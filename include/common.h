@@ -4,6 +4,7 @@
 
 #include "omp.h"
 #include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <cmath>
 #include <cublas_v2.h>
@@ -135,12 +136,12 @@ using VType = uint32_t;
 using SplittingPoints = std::vector<std::vector<int>>;
 
 inline size_t generateGuid() {
-    static size_t guid = 0;
+    static std::atomic<size_t> guid(0);
     return guid++;
 }
 
 inline uint64_t generateHash() {
-    static uint64_t tag = 0;
+    static std::atomic<uint64_t> tag(0);
     uint64_t hash = std::hash<uint64_t>()(tag++);
     return hash;
 }
@@ -151,6 +152,18 @@ inline uint64_t hashAppend(uint64_t a, uint64_t b) {
 
 inline uint64_t hashPack(uint64_t x) { return (x * 10000103) % 2147483647; }
 
+// 64-bit hashes for graph structure, hashAppend/hashPack keep only 31 bits
+inline uint64_t hashMix(uint64_t x) {
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+}
+
+inline uint64_t hashCombine(uint64_t seed, uint64_t x) {
+    return hashMix(seed ^ (hashMix(x) + 0x9e3779b97f4a7c15ull + (seed << 6) +
+                           (seed >> 2)));
+}
+
 inline VType powVType(VType val, int pow) {
     VType ret = 1;
     for (int i = 0; i < pow; ++i)
@@ -0,0 +1,33 @@
+#ifndef CPU_KERNEL_H
+#define CPU_KERNEL_H
+
+#include "common.h"
+
+namespace tpm {
+
+// Reference kernels for the uint32 verification data. Results wrap around
+// like the naive loops, so the blocking and vectorization do not change any
+// output bit.
+namespace cpu {
+
+// C = A * B with row-major B and C. A(i, j) is read from A[i * rsA + j * csA],
+// so a transposed A is read in place.
+void gemm(int m, int n, int k, const VType *A, size_t rsA, size_t csA,
+          const VType *B, size_t ldb, VType *C, size_t ldc,
+          bool parallel = true);
+
+// Gather the receptive fields of output pixels [p0, p0 + np) for channels
+// [c0, c0 + nc) of one image into col, a (nc * r * s) x np row-major matrix.
+// Padded positions are zero.
+void im2col(const VType *input, int h, int w, int c0, int nc, int r, int s,
+            int ph, int pw, int sh, int sw, int dh, int dw, int ow, int p0,
+            int np, VType *col);
+
+// name of the vector path used by the kernels
+const char *isaName();
+
+} // namespace cpu
+
+} // end of namespace tpm
+
+#endif // CPU_KERNEL_H
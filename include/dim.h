@@ -1,6 +1,7 @@
 #ifndef DIM_H
 #define DIM_H
 
+#include <algorithm>
 #include <cassert>
 #include <string>
 #include <vector>
@@ -69,16 +70,29 @@ inline Dim cntToIdx(const Dim &dim, size_t i) {
     return it;
 }
 
+// strides of a tensor of dims laid out in row-major order
+inline Dim denseStrides(const Dim &dims) {
+    Dim ret(dims.size(), 1);
+    for (size_t i = dims.size(); i > 1; --i)
+        ret[i - 2] = ret[i - 1] * dims[i - 1];
+    return ret;
+}
+
 class DimRange {
     enum State {
         AllPos,
         Empty,
         SinglePos,
         RangePos,
+        // a few boxes, begin and end bound them
+        BoxList,
         Invalid,
     };
 
     Dim begin, end; // closed interval [begin, end]
+    // distance between the positions of a box in each dim, empty if dense
+    Dim step;
+    std::vector<DimRange> boxes;
     State state;
 
     DimRange(State state) : begin({}), end({}), state(state) {}
@@ -105,13 +119,17 @@ class DimRange {
             }
             if (begin[i] != end[i]) {
                 state = RangePos;
-                return;
             }
         }
     }
 
+    // a strided box, end is rounded down to the last position
+    DimRange(const Dim &begin, const Dim &end, const Dim &step);
+
     DimRange(const DimRange &rhs)
-        : begin(rhs.begin), end(rhs.end), state(rhs.state){};
+        : begin(rhs.begin), end(rhs.end), step(rhs.step), boxes(rhs.boxes),
+          state(rhs.state){};
+    DimRange &operator=(const DimRange &rhs) = default;
 
     Dim &getBegin() { return begin; }
     const Dim &getBegin() const { return begin; }
@@ -119,8 +137,18 @@ class DimRange {
     Dim &getEnd() { return end; }
     const Dim &getEnd() const { return end; }
 
+    const Dim &getStep() const { return step; }
+    int getStep(size_t i) const { return step.empty() ? 1 : step[i]; }
+
+    const std::vector<DimRange> &getBoxes() const { return boxes; }
+
     bool isSinglePos() const { return state == SinglePos; }
 
+    // a single position or a box, which can be walked with next
+    bool isBox() const { return state == SinglePos || state == RangePos; }
+
+    bool isBoxList() const { return state == BoxList; }
+
     bool isEmpty() const { return state == Empty; }
 
     bool isAllPos() const { return state == AllPos; }
@@ -134,25 +162,39 @@ class DimRange {
     static DimRange getEmpty() { return DimRange(Empty); }
 
     static DimRange getAllPos() { return DimRange(AllPos); }
-};
 
-inline DimRange unionRange(const DimRange &lhs, const DimRange &rhs) {
-    if (lhs.notValid() || rhs.notValid()) {
-        return DimRange::getInvalid();
-    }
-    if (lhs.isAllPos() || rhs.isAllPos()) {
-        return DimRange::getAllPos();
-    }
-    if (lhs.isEmpty()) {
-        return DimRange(rhs);
-    }
-    if (rhs.isEmpty()) {
-        return DimRange(lhs);
+    // a list of boxes, which are not merged
+    static DimRange getBoxList(const std::vector<DimRange> &boxes);
+
+    // advance pos to the next position of a box in row-major order, false
+    // after the last one
+    bool next(Dim &pos) const {
+        for (int i = (int)pos.size() - 1; i >= 0; --i) {
+            if (pos[i] < end[i]) {
+                pos[i] += getStep(i);
+                return true;
+            }
+            pos[i] = begin[i];
+        }
+        return false;
     }
-    auto newBegin = elementwiseMin(lhs.getBegin(), rhs.getBegin());
-    auto newEnd = elementwiseMax(lhs.getEnd(), rhs.getEnd());
-    return DimRange(newBegin, newEnd);
-}
+
+    // number of positions of a box, or the sum over a box list
+    size_t size() const;
+    // whether every position of the box rhs is in this box
+    bool covers(const DimRange &rhs) const;
+};
+
+// the box [begin, end] clipped to a tensor of dims, empty if they do not
+// overlap
+DimRange clipRange(Dim begin, Dim end, const Dim &dims, const Dim &step = {});
+
+// a range holding both ranges. Boxes that differ in one dim are merged into
+// a strided box when their positions are evenly spaced, and others are kept
+// in a box list. A list longer than maxBoxes is bounded by a box strided by
+// the gcd of the offsets of its boxes.
+DimRange unionRange(const DimRange &lhs, const DimRange &rhs,
+                    size_t maxBoxes = 8);
 
 } // namespace tpm
 
@@ -2,6 +2,11 @@
 #define GENERATOR_H
 
 #include "graph.h"
+#include "index_map.h"
+#include "op_pool.h"
+#include "sampling.h"
+#include "search_stats.h"
+#include <set>
 #include <unordered_set>
 
 #define EQOPT if (!enable_eq_opt) { \
@@ -14,15 +19,24 @@
 namespace tpm {
 
 class Reciprocity;
+class MutationRules;
 
 class Generator {
+    // preprocessing steps are referenced by name in rule files
+    friend class MutationRules;
+    typedef void (Generator::*Preprocess)(SubGraph *);
+
     float equal_threshold;
     size_t num_valid_tensors, num_total_tensors;
     int max_depth;
     SubGraph *searchingGraph;
-    size_t max_num_elements;
+    // data of the searching tensors
+    TensorArena arena;
     size_t num_reserve_ops;
     size_t group_size;
+    // cleared ops of the past runs, reused for the candidate ops of the
+    // next ones
+    OpPool opPool;
     std::vector<OpVec> all_ops;
     OpVec oplist;
 
@@ -31,16 +45,65 @@ class Generator {
     std::shared_ptr<Reciprocity> reciprocity;
 
     std::vector<std::vector<std::pair<Dim, VType>>> computingPos;
+    SamplingPolicy sampling;
+    // searches with only transpose candidates over a graph of transposes
+    // compare index maps of the outputs, and never compute their data
+    bool symbolic_only;
+    std::vector<IndexMap> refIndexMaps;
+    // dims of the outputs of the searched graph, checked on the shape of a
+    // candidate op before its output tensor is allocated
+    std::vector<Dim> target_dims;
+    // numbers of elements of the outputs
+    std::set<size_t> target_sizes;
+    // all candidate ops keep the number of elements of their input
+    bool size_preserving;
+    // memo of reachesTarget
+    std::map<std::pair<Dim, int>, bool> reachable;
 
     OpVec computation_ops;
 
-    // box verification
-    bool enable_box_verification = false;
+    // verify mutants on the boxes between the splitting points of the outputs
+    // instead of sampling points, enabled by PET_VERIFY=box
+    bool enable_box_verification;
+
+    // Mutants of a searched graph with the rule keys of the passes that found
+    // them. Their tensors are bound to the inputs and outputs of the graph
+    // with the same canonical hash that hits the entry.
+    struct CachedMutants {
+        std::vector<uint64_t> inputs, outputs;
+        std::vector<std::shared_ptr<SubGraph>> graphs;
+        std::vector<std::string> rules;
+    };
+    // keyed by the canonical hash of the searched graph
+    std::map<uint64_t, CachedMutants> mutationCache;
 
-    std::map<uint64_t, std::vector<std::shared_ptr<SubGraph>>> mutationCache;
+    // counters of the last run, also added to SearchStats
+    SearchCounters counters;
+    // graph type and shape family of the running search, and the rule keys
+    // of the mutants it found, see RuleStats
+    std::string run_type, run_family;
+    std::vector<std::string> mutantRules;
 
     bool enable_eq_opt, enable_non_eq_opt;
 
+    // rules loaded from PET_MUTATION_RULES replace the built-in candidate ops
+    // of the graphs they match
+    std::shared_ptr<MutationRules> rules;
+
+    // parallel dfs: branches below the search root are handed out to worker
+    // generators, each with its own searching graph and visited set
+    int num_workers;
+    std::vector<std::unique_ptr<Generator>> workers;
+    // only used by workers
+    int split_depth;
+    std::atomic<size_t> *next_branch;
+    size_t claimed_branch, num_branches, cur_branch;
+    std::vector<size_t> found_branches;
+    OpVec synced_ops;
+
+    // a worker of master, configured by master instead of the environment
+    explicit Generator(const Generator *master);
+
   public:
     enum SGType {
         Empty,
@@ -56,9 +119,17 @@ class Generator {
         Others,
     };
     Generator(bool prune_reciprocity = true);
+    // the searching graph, the arena and the workers are owned
+    Generator(const Generator &) = delete;
+    Generator &operator=(const Generator &) = delete;
     ~Generator() {
-        if (searchingGraph != nullptr)
+        for (auto &opv : all_ops)
+            opPool.release(opv);
+        // the ops of the searching graph are owned by the pool
+        if (searchingGraph != nullptr) {
+            searchingGraph->getOperators().clear();
             delete searchingGraph;
+        }
     }
     void run(SubGraph *in_graph, std::vector<SubGraph *> &out_graphs,
              int mdepth = -1,
@@ -74,6 +145,10 @@ class Generator {
     bool approx_equal(Tensor *a, Tensor *b);
     bool approx_equal(const SubGraph *mutant_graph, size_t midx,
                       const SubGraph *input_graph, size_t iidx);
+    // compare index maps of transpose-only graphs, computing the data only
+    // if the mutant output is not a digit permutation of its input
+    bool symbolic_equal(const SubGraph *mutant_graph, size_t midx,
+                        const SubGraph *input_graph, size_t iidx);
     bool approx_equal_splitting_points(const SubGraph *mutant_graph,
                                        size_t midx, const SubGraph *input_graph,
                                        size_t iidx);
@@ -81,8 +156,39 @@ class Generator {
     void runForGroupConv(SubGraph *in_graph,
                          std::vector<SubGraph *> &out_graphs);
     SGType statGraph(SubGraph *sg);
+    static const char *getTypeName(SGType type);
+    // coarse shape of the first op for RuleStats, e.g. "3x3s" for a strided
+    // 3x3 conv, with "d" for dilated and "g" for grouped convs
+    static std::string getShapeFamily(SubGraph *sg);
     uint64_t computeHashForSingleComputeOp(const Operator *op);
 
+    const SearchCounters &getSearchCounters() const { return counters; }
+    const OpPool &getOpPool() const { return opPool; }
+    // rule keys of the mutants added to out_graphs by the last run, in order
+    const std::vector<std::string> &getMutantRules() const {
+        return mutantRules;
+    }
+
+    // number of elements used by the searching tensors at most
+    size_t getArenaPeak() const { return arena.getPeak(); }
+
+    void setSamplingPolicy(const SamplingPolicy &policy) { sampling = policy; }
+    const SamplingPolicy &getSamplingPolicy() const { return sampling; }
+
+    void setMutationRules(const std::shared_ptr<MutationRules> &r) {
+        rules = r;
+    }
+
+    void setBoxVerification(bool enable) { enable_box_verification = enable; }
+    bool getBoxVerification() const { return enable_box_verification; }
+
+    void setNumWorkers(int n) { num_workers = std::max(n, 1); }
+    int getNumWorkers() const { return num_workers; }
+
+    // a generator with the configuration of this one but its own search
+    // state, for threads that search other graphs
+    std::shared_ptr<Generator> makeSibling() const;
+
   private:
     // // find reciprocities among given ops
     // void search_reciprocity(OpVec &ops);
@@ -97,8 +203,33 @@ class Generator {
     bool have_computeOp_ancestor(Tensor *tensor);
     // pruning if an op with the same inputs exist
     bool have_same_op(Operator *op);
+    // pruning if no graph with op on input at depth can produce the outputs
+    // within max_depth ops
+    bool shapeReachable(Operator *op, const Tensor *input, int depth);
+    // whether at most steps candidate transposes take dims to the dims of an
+    // output
+    bool reachesTarget(const Dim &dims, int steps);
 
     void resetGraph(const SubGraph *in_graph);
+    // dfs from in_graph preprocessed by pre unless RuleStats skips the pass
+    void runPass(const std::string &pass, Preprocess pre, SubGraph *in_graph,
+                 std::vector<SubGraph *> &out_graphs,
+                 std::unordered_set<uint64_t> &visited);
+    std::string getRuleKey(const std::string &pass) const;
+    // the splitGroupConv mutants of a NormalConv, unless RuleStats skips them
+    void runSplitGroupPass(SubGraph *in_graph,
+                           std::vector<SubGraph *> &out_graphs);
+    // false if PET_DISABLE_*_OPT turns off the candidates of graphs of type
+    bool isCandidateTypeEnabled(SGType type) const;
+
+    // dfs from the current oplist, split across workers if enabled
+    void runDfs(SubGraph *in_graph, std::vector<SubGraph *> &out_graphs,
+                std::unordered_set<uint64_t> &visited);
+    // copy the searching state of master so that dfs can continue here
+    void syncWith(Generator &master);
+    void resetWorker();
+    // whether the worker should search the branch entered at depth
+    bool claimBranch(int depth);
 
     void addCandidateOpsForConv1x1(
         std::vector<std::shared_ptr<Operator>> &candidate_ops, SubGraph *sg);
@@ -130,6 +261,10 @@ class Generator {
     void addPreprocessForTransposeGroupConvSR(SubGraph *sg);
     uint64_t computeHashForSingleConv(Operator *op);
     void addToCache(SubGraph *sg, std::vector<SubGraph *> &out_graphs);
+    // a copy of mutant idx of entry reading and writing the tensors of
+    // in_graph
+    SubGraph *loadCached(const CachedMutants &entry, size_t idx,
+                         SubGraph *in_graph);
     void markTransType(SubGraph *inputGraph, SubGraph *outputGraph);
     void splitGroupConv(SubGraph *sg, std::vector<SubGraph *> &out_graphs);
     bool validDepth(SubGraph *sg);
@@ -151,6 +286,14 @@ class Reciprocity {
     std::vector<std::vector<uint64_t>> reciprocal_op_chains;
 
     int maxDetectDepth() const { return MAX_RECIPROCITY_DETECT_DEPTH; }
+
+    // Chains are only searched once per set of transposes and kept in a
+    // table shared by the process. The table is loaded from and saved to
+    // PET_RECIPROCITY_FILE if it is set.
+    static int loadTable(const std::string &file);
+    static int saveTable(const std::string &file);
+    static void clearTable();
+    static size_t tableSize();
 };
 } // end of namespace tpm
 #endif
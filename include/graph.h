@@ -4,6 +4,7 @@
 #include "operator.h"
 #include "tensor.h"
 #include <memory>
+#include <unordered_map>
 
 namespace tpm {
 
@@ -17,6 +18,9 @@ class GraphBase {
   public:
     ~GraphBase();
 
+    // release the data of all the tensors, in one call per allocator
+    void dataFree();
+
     Tensor *tensor(const Dim &dims, Tensor::DataType dtype = Tensor::Float32);
     Tensor *tensor(const Dim &dims, const std::string &dtype);
     void addTensor(Tensor *tensor);
@@ -147,9 +151,14 @@ class SubGraph : public GraphBase {
   private:
     int findTensor(Tensor *tensor, int ntensor = 0);
     uint64_t hash;
+    uint64_t computeHash(bool canonical);
+    // op labels in op order, from the labels of the graph inputs
+    std::vector<uint64_t> refineLabels(
+        const std::unordered_map<const Operator *, int> &nodeMap,
+        const std::unordered_map<const Tensor *, uint64_t> &inputLabels);
 
   public:
-    SubGraph() {}
+    SubGraph() : hash(2147483647) {}
     SubGraph(OpVec oplist);
     SubGraph(const SubGraph &rhs) : SubGraph(rhs.ops) {}
     void cleanConnection();
@@ -160,7 +169,12 @@ class SubGraph : public GraphBase {
      */
     const std::pair<bool, VType> compute(const Dim &point, size_t outputId = 0,
                                          bool getAllPos = false) const;
+    // 64-bit hash of the structure and the identity of the input tensors
     uint64_t getHash();
+    // only depends on op types, attributes, shapes and connections, including
+    // which inputs are shared, so it is the same for equal graphs built in
+    // different processes
+    uint64_t getCanonicalHash();
     int print();
     int printBrief();
     int getComputeOps(std::vector<Operator *> &ops);
@@ -174,6 +188,35 @@ class SubGraph : public GraphBase {
               std::shared_ptr<SubGraph> &slave);
 };
 
+// Compiled form of SubGraph::compute for one output. The evaluation order and
+// tensor indices are built once, and a batch of points is computed by a single
+// range propagation and one call of each op runner.
+class ComputePlan {
+    size_t outputId;
+    bool valid;
+    // dfs post-order of the ops, runners are called in reverse
+    std::vector<Operator *> order;
+    std::vector<std::vector<size_t>> inputIds, outputIds;
+    std::vector<size_t> graphOutputIds;
+    // per run state
+    std::vector<DimRange> drs;
+    std::vector<char> hasDr;
+    std::vector<std::function<bool()>> runners;
+    // kept across runs to reuse their storage
+    std::vector<DimRange> boxes, inDrs;
+    Tensor *target;
+
+  public:
+    ComputePlan(const SubGraph *graph, size_t outputId = 0);
+    bool isValid() const { return valid; }
+    // compute the part of the output in dr
+    bool run(const DimRange &dr);
+    // compute the output at one point
+    bool compute(const Dim &point, VType &value);
+    // compute the output at each point in a single run
+    bool compute(const std::vector<Dim> &points, std::vector<VType> &values);
+};
+
 } // end of namespace tpm
 
 #endif // GRAPH_H
@@ -0,0 +1,57 @@
+#ifndef INDEX_MAP_H
+#define INDEX_MAP_H
+
+#include "common.h"
+#include "dim.h"
+
+namespace tpm {
+
+class Tensor;
+class TransposeOp;
+
+// Symbolic index function of a tensor produced by a chain of transposes.
+// Each dim of the tensor is a list of digits from outer to inner, and a
+// digit with value v in [0, radix) adds v * stride to the linear index of
+// the source tensor. Splitting, fusing and reordering dims only regroups
+// digits, so two chains can be compared without computing any data.
+class IndexMap {
+  public:
+    struct Digit {
+        int64_t stride;
+        int radix;
+        bool operator==(const Digit &rhs) const {
+            return stride == rhs.stride && radix == rhs.radix;
+        }
+    };
+
+  private:
+    uint64_t source;
+    std::vector<std::vector<Digit>> dims;
+
+  public:
+    IndexMap() : source(0) {}
+    // identity map of tensor
+    explicit IndexMap(const Tensor *tensor);
+
+    // map the output of op, whose input is the current tensor. Returns false
+    // if a split does not fall on digit boundaries that can be refined.
+    bool apply(const TransposeOp *op);
+
+    Dim getDims() const;
+    uint64_t getSource() const { return source; }
+
+    // digits of the linear index with radix-1 digits dropped and adjacent
+    // digits that are contiguous in the source merged
+    std::vector<Digit> canonical() const;
+
+    bool operator==(const IndexMap &rhs) const;
+    bool operator!=(const IndexMap &rhs) const { return !(*this == rhs); }
+
+    // trace tensor back through Transpose and Identity ops to its source;
+    // false if any other op is met
+    static bool fromTensor(Tensor *tensor, IndexMap &map);
+};
+
+} // end of namespace tpm
+
+#endif // INDEX_MAP_H
@@ -0,0 +1,78 @@
+#ifndef MUTATION_RULES_H
+#define MUTATION_RULES_H
+
+#include "generator.h"
+#include <functional>
+#include <istream>
+
+namespace tpm {
+
+// Mutation rules in a line based text format. The rules matching a graph
+// replace the built-in candidate ops of its SGType, graphs no rule matches
+// keep the built-in ones.
+//
+//   # '#' starts a comment
+//   rule n2h NormalConv depth 3
+//     when in0.0 % 2 == 0
+//     op transpose 0 0,1,{-1,2},3 2 N2H
+//     op conv inherit 1 1 1 1
+//     preprocess PadSlice
+//   end
+//
+// A rule applies if all its "when" predicates hold on the first op of the
+// graph. Keys are "ops", "inI.J" / "outI.J" for dim J of input / output I,
+// ph/pw/sh/sw/dh/dw of a conv and transA/transB of a matmul. Ops are
+// transpose, conv, matmul, pad, slice, concat, split, extend and identity,
+// with the same arguments as their shape-less constructors; "conv inherit"
+// takes the padding mode of the conv in the graph, "split <dim> gcd" splits
+// dim in proportion to dim of the outputs of the ops in the graph and
+// "clone" is the first op of the graph. "group <n>" or "group ops" makes
+// concats join n or one input per op of the graph, as in grouped convs.
+// Every preprocessing step starts its own dfs from the preprocessed graph.
+class MutationRules {
+  public:
+    typedef Generator::Preprocess Preprocess;
+
+    struct Predicate {
+        std::string key;
+        int mod;
+        std::string cmp;
+        int value;
+        bool eval(SubGraph *sg) const;
+    };
+
+    struct Rule {
+        std::string name;
+        Generator::SGType type;
+        int depth;
+        // inputs of a concat, -1 for one per op of the graph, 0 if not set
+        int group;
+        std::vector<Predicate> when;
+        // ops are created per graph since some take attributes from it
+        std::vector<std::function<Operator *(SubGraph *)>> ops;
+        std::vector<Preprocess> preprocess;
+        bool applicable(SubGraph *sg) const;
+    };
+
+  private:
+    std::vector<Rule> rules;
+
+    static bool parsePreprocess(const std::string &str, Preprocess &pre);
+
+  public:
+    // rules are appended to the loaded ones
+    int load(std::istream &is);
+    int loadFile(const std::string &file);
+
+    bool hasRules(Generator::SGType type) const;
+    // rules of type whose predicates hold on sg
+    std::vector<const Rule *> match(Generator::SGType type,
+                                    SubGraph *sg) const;
+    size_t size() const { return rules.size(); }
+
+    static bool parseType(const std::string &str, Generator::SGType &type);
+};
+
+} // end of namespace tpm
+
+#endif // MUTATION_RULES_H
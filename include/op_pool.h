@@ -0,0 +1,40 @@
+#ifndef OP_POOL_H
+#define OP_POOL_H
+
+#include "operator.h"
+#include <unordered_map>
+
+namespace tpm {
+
+// Free lists of cleared operators by hash. An op released to the pool is
+// cleared instead of deleted, and handed out again in place of a clone of
+// an op with the same type and parameters.
+class OpPool {
+    std::unordered_map<uint64_t, OpVec> freeOps;
+    size_t numFree, numCreated, numReused;
+
+    // same attributes, including the state set on transposes by
+    // markTransType that the hash does not cover
+    static bool sameParams(Operator *a, Operator *b);
+
+  public:
+    OpPool() : numFree(0), numCreated(0), numReused(0) {}
+    OpPool(const OpPool &) = delete;
+    OpPool &operator=(const OpPool &) = delete;
+    ~OpPool() { clear(); }
+
+    // a cleared op equal to proto, cloned if none is free
+    Operator *acquire(Operator *proto);
+    void release(Operator *op);
+    void release(OpVec &ops);
+    // delete all the free ops
+    void clear();
+
+    size_t getFree() const { return numFree; }
+    size_t getCreated() const { return numCreated; }
+    size_t getReused() const { return numReused; }
+};
+
+} // end of namespace tpm
+
+#endif // OP_POOL_H
@@ -175,15 +175,30 @@ class Operator {
     size_t getGuid() const { return guid; }
 
     uint64_t getHash() const { return hash; }
+    // only for restoring serialized ops
+    void setHash(uint64_t h) { hash = h; }
 
     OpType getType() const { return type; }
 
-    virtual void inferSplittingPoints() {
-        fprintf(stderr, "This op has unrealized inferSplittingPoints.\n");
-        assert(false);
-    }
+    // Ops without an inference leave their outputs without splitting points,
+    // and mutants through them are verified by sampling
+    virtual void inferSplittingPoints() { clearSplittingPoints(); }
 
   protected:
+    void clearSplittingPoints() {
+        for (auto output : outputs)
+            output->clearSplittingPoints();
+    }
+    // all inputs have splitting points, otherwise the outputs get none
+    bool checkSplittingPoints() {
+        for (auto input : inputs)
+            if (!input->hasSplittingPoints()) {
+                clearSplittingPoints();
+                return false;
+            }
+        return true;
+    }
+
     const size_t guid;
     uint64_t hash;
     OpType type;
@@ -565,6 +580,9 @@ class SplitOp : public Operator {
 
     SplitOp(int dim, const std::vector<int> &sizes);
 
+    // an equal split with the sizes already computed, see Serializer
+    SplitOp(int dim, int num, const std::vector<int> &sizes);
+
     SplitOp(const SplitOp &rhs)
         : Operator(rhs), dim(rhs.dim), num(rhs.num), sizes(rhs.sizes) {}
 
@@ -610,6 +628,7 @@ class SplitOp : public Operator {
     int numOutputs() override { return 2; }
 
     int getDim() const { return dim; }
+    int getNum() const { return num; }
 
   private:
     int dim, num;
@@ -732,6 +751,9 @@ class TransposeOp : public Operator {
 
     bool checkValid(const TensorVec &inputs) override;
     void initHash() override;
+    // input position of the output position pos, where flatDims are the
+    // input dims with the split dim divided
+    Dim getInputPos(const Dim &flatDims, const Dim &pos) const;
 
   public:
     TransposeOp(Tensor *input, Tensor *output, const Perm &before,
@@ -754,6 +776,8 @@ class TransposeOp : public Operator {
     compute(DimRange dr) override;
 
     Dim computeShape() override;
+    // output dims for an input of inputDims, empty if it cannot be split
+    Dim inferShape(const Dim &inputDims) const;
 
     double perf(PerfEngine *pe, int rounds, int warmupRounds) override;
 
@@ -775,6 +799,10 @@ class TransposeOp : public Operator {
         padding_h = h;
         padding_w = w;
     }
+    const Perm &getBefore() const { return before; }
+    const Perm &getAfter() const { return after; }
+    int getSplit() const { return split; }
+    int getFactor() const { return factor; }
 
   private:
     int split, factor;
@@ -883,6 +911,13 @@ class BatchNormOp : public Operator {
 
     int numOutputs() override { return 1; }
 
+    float getEpsilon() const { return epsilon; }
+    float getMomentum() const { return momentum; }
+    Tensor *getScale() const { return scale; }
+    Tensor *getBias() const { return bias; }
+    Tensor *getMean() const { return mean; }
+    Tensor *getVar() const { return var; }
+
   private:
     float epsilon, momentum;
     Tensor *scale, *bias, *mean, *var;
@@ -1220,6 +1255,8 @@ class PowOp : public Operator {
 
     int numOutputs() override { return 1; }
 
+    int getPow() const { return pow; }
+
   private:
     int pow;
 };
@@ -1315,6 +1352,8 @@ class ReduceMeanOp : public Operator {
 
     int numOutputs() override { return 1; }
 
+    int getAxis() const { return axis; }
+
   private:
     int axis;
 };
@@ -1406,7 +1445,8 @@ class IdentityOp : public Operator {
     int numOutputs() override { return 1; }
 
     void inferSplittingPoints() override {
-        outputs[0]->setSplittingPoints(*inputs[0]->getSplittingPoints());
+        if (checkSplittingPoints())
+            outputs[0]->setSplittingPoints(*inputs[0]->getSplittingPoints());
     };
 };
 
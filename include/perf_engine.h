@@ -5,11 +5,22 @@
 #include "perf.h"
 #include <cstdint>
 #include <cuda.h>
+#include <istream>
 #include <map>
+#include <ostream>
 
 namespace tpm {
 
 class PerfEngine {
+  public:
+    // perf tables parsed by parsePerfData, see loadPerfData
+    struct PerfData {
+        std::map<ConvArgs, ConvResult> convPerf;
+        std::map<MatmulArgs, MatmulResult> matmulPerf;
+        std::map<PoolArgs, float> maxPoolPerf;
+        std::map<PoolArgs, float> avgPoolPerf;
+    };
+
   private:
     int penaltyFlag = 1;
     std::map<ConvArgs, ConvResult> convPerf;
@@ -113,6 +124,12 @@ class PerfEngine {
     }
 
     void dumpPerfData();
+    // save and load the perf tables in a plain-text format
+    void savePerfData(std::ostream &os) const;
+    // a failed load leaves the tables unchanged
+    int loadPerfData(std::istream &is);
+    static int parsePerfData(std::istream &is, PerfData &data);
+    void mergePerfData(const PerfData &data);
 };
 
 } // namespace tpm
@@ -0,0 +1,78 @@
+#ifndef RULE_STATS_H
+#define RULE_STATS_H
+
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+
+namespace tpm {
+
+// History of the mutation passes of Generator::run, keyed by SGType, pass
+// and shape family of the searched graph, e.g. "TransposeGroupConv.RS@1x1".
+// A hit is a mutant of the pass in the best graph of a partition, with the
+// latency it saves there. Between beginPartition and endPartition a pass is
+// counted as run once however often the search runs it, so that runs and
+// hits are both counted per partition. The history is loaded from and saved
+// to PET_RULE_STATS, and PET_RULE_SKIP=<rate> skips the passes whose hit
+// rate stays below rate after enough runs.
+class RuleStats { // Singleton Pattern
+  public:
+    struct Entry {
+        uint64_t runs = 0, mutants = 0, hits = 0;
+        double gain = 0;
+    };
+
+  private:
+    std::string path;
+    std::mutex mtx;
+    std::map<std::string, Entry> entries;
+    // skipping is disabled with minHitRate <= 0
+    double minHitRate;
+    uint64_t minRuns;
+    // passes run in the partition being searched
+    bool inPartition;
+    std::set<std::string> partitionRuns;
+
+    RuleStats();
+    ~RuleStats();
+    RuleStats(const RuleStats &) = delete;
+    RuleStats &operator=(const RuleStats &) = delete;
+
+  public:
+    static RuleStats &getInstance() {
+        static RuleStats instance;
+        return instance;
+    }
+
+    void beginPartition();
+    void endPartition();
+    void recordRun(const std::string &key, size_t mutants);
+    void recordHit(const std::string &key, double gain);
+    // whether the pass has run minRuns times with a hit rate below minHitRate
+    bool shouldSkip(const std::string &key);
+    void setSkipping(double minHitRate_, uint64_t minRuns_ = 8) {
+        minHitRate = minHitRate_;
+        minRuns = minRuns_;
+    }
+
+    Entry get(const std::string &key);
+    std::map<std::string, Entry> getAll();
+    void clear();
+
+    // "rules <n>" and one "<key> <runs> <mutants> <hits> <gain>" line per
+    // entry; loaded entries replace those with the same keys
+    void saveData(std::ostream &os);
+    int loadData(std::istream &is);
+    static int parseData(std::istream &is, std::map<std::string, Entry> &data);
+    void mergeData(const std::map<std::string, Entry> &data);
+    const std::string &getPath() const { return path; }
+    int save(const std::string &file);
+    int load(const std::string &file);
+};
+
+} // end of namespace tpm
+
+#endif // RULE_STATS_H
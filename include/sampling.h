@@ -0,0 +1,47 @@
+#ifndef SAMPLING_H
+#define SAMPLING_H
+
+#include "common.h"
+#include "dim.h"
+
+namespace tpm {
+
+// How Generator picks the output positions used to verify mutants.
+// Options can be set with PET_SAMPLE_COUNT, PET_SAMPLE_MODE
+// (grid/stratified/boundary), PET_SAMPLE_SEED and PET_SAMPLE_MAX_MISMATCH.
+class SamplingPolicy {
+  public:
+    enum Mode {
+        // each coordinate at d/3 or 2d/3
+        Grid,
+        // latin hypercube over the output, one point per stratum and dim
+        Stratified,
+        // mostly edges, midpoints and both sides of the splitting points,
+        // where padding and splitting differ
+        Boundary,
+    };
+
+    int count;
+    Mode mode;
+    uint32_t seed;
+    // reject once this many points mismatch, 0 to only use the threshold
+    int maxMismatches;
+
+    SamplingPolicy(int count = 8, Mode mode = Grid, uint32_t seed = 0,
+                   int maxMismatches = 0)
+        : count(count), mode(mode), seed(seed), maxMismatches(maxMismatches) {}
+    static SamplingPolicy fromEnv();
+
+    // the same dims, output index, splitting points and seed always give the
+    // same points
+    std::vector<Dim>
+    samplePoints(const Dim &dims, size_t outputId = 0,
+                 const SplittingPoints *splits = nullptr) const;
+    // whether the mismatches seen so far already decide a rejection, given
+    // that a mutant needs more than threshold of the points to match
+    bool shouldReject(int mismatches, float threshold) const;
+};
+
+} // end of namespace tpm
+
+#endif // SAMPLING_H
@@ -5,7 +5,9 @@
 #include "graph.h"
 #include "operator.h"
 #include "trans_eliminator.h"
+#include <mutex>
 #include <unordered_map>
+#include <unordered_set>
 
 namespace tpm {
 class SearchEngine {
@@ -16,11 +18,58 @@ class SearchEngine {
     int partitionThreshold =
         3; // cut nodes whose #in + #out >= partitionThreshold
     int GRAPH_SIZE = 5;
+    // number of mutationEngine->run calls per getMutation for budgeted
+    // strategies
+    int MUTATION_BUDGET = 64;
+    int TOURNAMENT_SIZE = 3;
+    // generator threads and queue capacity of the mutation pipeline
+    int MUTATION_THREADS = 1;
+    int MUTATION_QUEUE_SIZE = 16;
+    // Scale search effort of each partition by its share of the baseline
+    // latency. Partitions and ops below negligibleShare are not mutated.
+    bool enableCostBudget = false;
+    double negligibleShare = 0.01;
+    double baselinePerf = 0;
+    int defaultMutationDepth, defaultMutationSize, defaultGraphSize;
     std::shared_ptr<PerfEngine> perfEngine;
     std::shared_ptr<Generator> mutationEngine;
+    // generators of the extra pipeline threads
+    std::vector<std::shared_ptr<Generator>> workerEngines;
     std::shared_ptr<TransEliminator> eliminateEngine;
     std::unordered_map<uint64_t, std::vector<std::shared_ptr<SubGraph>>>
         mutationArchive;
+    // rule keys of the passes that produced a mutated compute op, keyed by
+    // the op and its tensors, to credit the rules of the best graphs
+    std::unordered_map<uint64_t, std::vector<std::string>> mutationOrigins;
+    // Graphs saved for checkpoints with the hashes of the inputs and outputs
+    // of the graph they were searched for. Tensor hashes are local to a
+    // process, so after a restart they are bound by position to the tensors
+    // of a graph with the same canonical hash.
+    struct SavedGraphs {
+        std::vector<uint64_t> inputs, outputs;
+        std::vector<std::string> graphs;
+    };
+    // mutated graphs by the canonical hash of the mutated graph
+    std::unordered_map<uint64_t, SavedGraphs> savedArchive;
+    // best graphs of finished partitions by the canonical hash and the index
+    // of the partition
+    std::map<std::pair<uint64_t, int>, SavedGraphs> savedParts;
+    std::string checkpointFile;
+
+    static int saveGraphs(SubGraph *source,
+                          const std::vector<std::shared_ptr<SubGraph>> &graphs,
+                          SavedGraphs &saved);
+    static int loadGraphs(const SavedGraphs &saved, SubGraph *target,
+                          std::vector<std::shared_ptr<SubGraph>> &graphs);
+
+  public:
+    enum MutationStrategy {
+        BfsStrategy,       // expand every candidate up to MUTATION_DEPTH
+        EvolutionStrategy, // tournament selection under MUTATION_BUDGET
+    };
+
+  private:
+    MutationStrategy mutationStrategy = BfsStrategy;
 
   public:
     struct GroupEdge {
@@ -76,6 +125,15 @@ class SearchEngine {
     int isMergeable(const std::shared_ptr<SubGraph> &graph);
     int isMutatable(const std::shared_ptr<SubGraph> &graph);
     int isSpecialMutation(Operator *, int depth);
+    bool isNegligible(const std::shared_ptr<SubGraph> &graph);
+    // set depth and beam width for a partition whose cost is ratio times
+    // the average partition cost
+    void setBudget(double ratio);
+    void resetBudget();
+    void setCostBudget(bool enable, double negligible = 0.01) {
+        enableCostBudget = enable;
+        negligibleShare = negligible;
+    }
     double getPerf(const std::shared_ptr<SubGraph> &graph,
                    bool profiling = false);
     int getMutation(std::shared_ptr<SubGraph> &graph,
@@ -83,6 +141,30 @@ class SearchEngine {
     int getSingleMutation(std::shared_ptr<SubGraph> &graph,
                           std::vector<std::shared_ptr<SubGraph>> &candidates);
     uint64_t getMutationHash(const Operator *op);
+    // record a hit in RuleStats for every rule behind the compute ops of
+    // best, which saves gain over the original partition
+    void creditRules(const std::shared_ptr<SubGraph> &best, double gain);
+    // run the generator on the compute op of graph and return the new
+    // candidates with their depths. mutationSet is guarded by lock if given.
+    int generateMutation(
+        Generator *engine, const std::shared_ptr<SubGraph> &graph, int depth,
+        int maxDepth, std::unordered_set<uint64_t> &mutationSet,
+        std::mutex *lock,
+        std::vector<std::pair<std::shared_ptr<SubGraph>, int>> &children);
+    // generate and profile the new candidates of candidate
+    int expandMutation(const Candidate &candidate, int depth, int maxDepth,
+                       std::unordered_set<uint64_t> &mutationSet,
+                       std::vector<Candidate> &q, std::vector<int> &f);
+    int searchMutationBfs(std::unordered_set<uint64_t> &mutationSet,
+                          std::vector<Candidate> &q, std::vector<int> &f);
+    int searchMutationEvolution(uint64_t seed,
+                                std::unordered_set<uint64_t> &mutationSet,
+                                std::vector<Candidate> &q,
+                                std::vector<int> &f);
+    void setMutationStrategy(MutationStrategy strategy) {
+        mutationStrategy = strategy;
+    }
+    void setMutationBudget(int budget) { MUTATION_BUDGET = budget; }
 
     // Partition a graph into disjoint subgraphs
     std::vector<std::shared_ptr<SubGraph>>
@@ -94,5 +176,14 @@ class SearchEngine {
     int stripDfs(Operator *op, std::unordered_map<int, int> &f, int flag);
 
     std::shared_ptr<PerfEngine> exportPerfEngine();
+    // the generator of the search, the pipeline threads copy its
+    // configuration when they are created
+    std::shared_ptr<Generator> exportMutationEngine();
+
+    // Checkpoint finished partitions, the mutation archive and the perf
+    // table after every partition. run() resumes from the file if it exists.
+    void setCheckpointFile(const std::string &file) { checkpointFile = file; }
+    int saveCheckpoint(const std::string &file);
+    int loadCheckpoint(const std::string &file);
 };
 } // namespace tpm
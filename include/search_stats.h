@@ -0,0 +1,60 @@
+#ifndef SEARCH_STATS_H
+#define SEARCH_STATS_H
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+
+namespace tpm {
+
+// Counters of the mutation search in Generator::run
+struct SearchCounters {
+    uint64_t runs = 0;
+    // dfs calls that were not pruned at entry
+    uint64_t nodes = 0;
+    // pruned as an already searched graph, a reciprocal transpose chain, an
+    // op with the same inputs as another, an unreachable output shape and a
+    // mutant with too deep transposes
+    uint64_t prunedVisited = 0, prunedReciprocity = 0, prunedSameOp = 0,
+             prunedShape = 0, prunedDepth = 0;
+    uint64_t verifications = 0, mutants = 0;
+    // passes skipped for their poor history in RuleStats
+    uint64_t skippedPasses = 0;
+    // microseconds
+    int64_t verifyTime = 0, runTime = 0;
+
+    void add(const SearchCounters &rhs);
+    std::string toJson() const;
+};
+
+// Search counters of all generators in the process by the SGType of the
+// searched graphs. The JSON report is written to PET_SEARCH_STATS at exit.
+class SearchStats { // Singleton Pattern
+    std::string path;
+    std::mutex mtx;
+    std::map<std::string, SearchCounters> byType;
+
+    SearchStats();
+    ~SearchStats();
+    SearchStats(const SearchStats &) = delete;
+    SearchStats &operator=(const SearchStats &) = delete;
+
+  public:
+    static SearchStats &getInstance() {
+        static SearchStats instance;
+        return instance;
+    }
+
+    void add(const std::string &type, const SearchCounters &counters);
+    std::map<std::string, SearchCounters> get();
+    SearchCounters getTotal();
+    void clear();
+
+    std::string toJson();
+    int dump(const std::string &file);
+};
+
+} // end of namespace tpm
+
+#endif // SEARCH_STATS_H
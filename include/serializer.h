@@ -0,0 +1,46 @@
+#ifndef SERIALIZER_H
+#define SERIALIZER_H
+
+#include "graph.h"
+#include <istream>
+#include <ostream>
+#include <unordered_map>
+
+namespace tpm {
+
+// Plain-text serialization of SubGraph structure for checkpoints and
+// persistent caches. Tensors keep their dims, types and penalty. Tensor
+// hashes are local to a process, so they only identify the tensors in the
+// text: loaded tensors get fresh hashes, except those bound to the tensors
+// of the model they connect to. Tensor data is not saved.
+class Serializer {
+  public:
+    static int saveGraph(std::ostream &os, SubGraph *graph);
+    // tensors saved with a hash in bind take the mapped hash
+    static std::shared_ptr<SubGraph>
+    loadGraph(std::istream &is,
+              const std::unordered_map<uint64_t, uint64_t> &bind = {});
+    // the text of the next graph, which is checked by loading it
+    static bool readGraph(std::istream &is, std::string &text);
+
+    static void saveDim(std::ostream &os, const Dim &dim);
+    static bool loadDim(std::istream &is, Dim &dim);
+    // save the attributes of op that are not part of the graph connections,
+    // OpPool compares ops by them
+    static int saveOpAttrs(std::ostream &os, Operator *op);
+
+  private:
+    static void saveTensor(std::ostream &os, Tensor *tensor);
+    static Tensor *loadTensor(std::istream &is, uint64_t &savedHash);
+    static void savePerm(std::ostream &os, const Perm &perm);
+    static bool loadPerm(std::istream &is, std::vector<PermItem> &perm);
+    // create an op of the given type and connect it to inputs and outputs,
+    // extra tensors are freed after loading and shared ones with the graph
+    static Operator *loadOp(std::istream &is, int type, const TensorVec &inputs,
+                            const TensorVec &outputs, TensorVec &extra,
+                            TensorVec &shared);
+};
+
+} // end of namespace tpm
+
+#endif // SERIALIZER_H
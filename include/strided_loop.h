@@ -0,0 +1,95 @@
+#ifndef STRIDED_LOOP_H
+#define STRIDED_LOOP_H
+
+#include "common.h"
+#include "dim.h"
+
+namespace tpm {
+
+// Walks the positions of dims in row-major order together with the offsets
+// of several operands, each read or written with its own strides, e.g. the
+// output and the broadcast inputs of an element-wise op. Adjacent dims are
+// merged when all the operands allow it, and the body is called once per
+// run of the innermost dim:
+//     body(offsets, n): n positions from offsets[k] of operand k, advancing
+//     by getInnerStride(k)
+class StridedLoop {
+    std::vector<size_t> dims;
+    // [operand][dim]
+    std::vector<std::vector<size_t>> strides;
+    size_t total;
+
+  public:
+    StridedLoop(const Dim &dims_, const std::vector<Dim> &strides_);
+
+    size_t size() const { return total; }
+    size_t getRunSize() const { return dims.empty() ? 1 : dims.back(); }
+    size_t getInnerStride(size_t k) const {
+        return strides[k].empty() ? 0 : strides[k].back();
+    }
+
+    // the positions in [begin, end)
+    template <typename F>
+    void forRange(size_t begin, size_t end, F &&body) const;
+    template <typename F> void forEach(F &&body) const {
+        forRange(0, total, body);
+    }
+    // one chunk of positions per thread, serial for less than two chunks of
+    // minChunk positions
+    template <typename F>
+    void parallelFor(F &&body, size_t minChunk = 4096) const;
+};
+
+template <typename F>
+void StridedLoop::forRange(size_t begin, size_t end, F &&body) const {
+    end = std::min(end, total);
+    if (begin >= end)
+        return;
+    auto nOperands = strides.size(), nDims = dims.size();
+    std::vector<size_t> offsets(nOperands, 0);
+    if (nDims == 0) {
+        body((const size_t *)offsets.data(), (size_t)1);
+        return;
+    }
+    std::vector<size_t> idx(nDims, 0);
+    auto rest = begin;
+    for (size_t i = nDims; i > 0; --i) {
+        idx[i - 1] = rest % dims[i - 1];
+        rest /= dims[i - 1];
+        for (size_t k = 0; k < nOperands; ++k)
+            offsets[k] += idx[i - 1] * strides[k][i - 1];
+    }
+    auto inner = nDims - 1;
+    for (auto pos = begin; pos < end;) {
+        auto n = std::min(dims[inner] - idx[inner], end - pos);
+        body((const size_t *)offsets.data(), n);
+        pos += n;
+        idx[inner] += n;
+        for (size_t k = 0; k < nOperands; ++k)
+            offsets[k] += n * strides[k][inner];
+        // carry, the offsets wrap around but end up in range
+        for (auto i = inner; i > 0 && idx[i] == dims[i]; --i) {
+            idx[i] = 0;
+            idx[i - 1]++;
+            for (size_t k = 0; k < nOperands; ++k)
+                offsets[k] += strides[k][i - 1] - dims[i] * strides[k][i];
+        }
+    }
+}
+
+template <typename F>
+void StridedLoop::parallelFor(F &&body, size_t minChunk) const {
+    if (total < 2 * minChunk) {
+        forRange(0, total, body);
+        return;
+    }
+#pragma omp parallel
+    {
+        size_t nThreads = omp_get_num_threads(), t = omp_get_thread_num();
+        forRange(total * t / nThreads, total * (t + 1) / nThreads, body);
+    }
+}
+
+} // end of namespace tpm
+
+#endif // STRIDED_LOOP_H
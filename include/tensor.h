@@ -3,6 +3,7 @@
 
 #include "common.h"
 #include "dim.h"
+#include "tensor_pool.h"
 
 namespace tpm {
 
@@ -36,6 +37,17 @@ class Tensor {
     OpVec inputOf;
     Operator *outputOf;
     VType *data;
+    // scratch tensors take data from an arena and return it on clear, the
+    // others use the default TensorPool
+    TensorAllocator *allocator;
+    // a view owns no data and reads that of viewBase at viewOffset through
+    // viewStrides, viewBase always owns its data
+    Tensor *viewBase;
+    size_t viewOffset;
+    Dim viewStrides;
+    // the number of views reading the data of this tensor, which is not freed
+    // while there are any
+    std::atomic<int> numViews;
     Dim it;
     DataType dtype;
     TensorType type;
@@ -51,10 +63,14 @@ class Tensor {
   public:
     Tensor(TensorType type = Input, DataType dtype = Float32)
         : guid(generateGuid()), hash(generateHash()), outputOf(nullptr),
-          data(nullptr), dtype(dtype), type(type), computed(NotComputed) {}
+          data(nullptr), allocator(nullptr), viewBase(nullptr), viewOffset(0),
+          numViews(0), dtype(dtype), type(type),
+          computed(NotComputed) {}
     Tensor(const Dim &dims, TensorType type = Input, DataType dtype = Float32)
         : guid(generateGuid()), hash(generateHash()), dims(dims),
-          outputOf(nullptr), data(nullptr), dtype(dtype), type(type),
+          outputOf(nullptr), data(nullptr), allocator(nullptr),
+          viewBase(nullptr), viewOffset(0), numViews(0), dtype(dtype),
+          type(type),
           computed(NotComputed) {
         itInit();
     }
@@ -67,14 +83,16 @@ class Tensor {
     }
     Tensor(VType scalar, TensorType type = Weight, DataType dtype = Float32)
         : guid(generateGuid()), hash(generateHash()), outputOf(nullptr),
-          data(nullptr), dtype(dtype), type(type), computed(ComputedFull) {
+          data(nullptr), allocator(nullptr), viewBase(nullptr), viewOffset(0),
+          numViews(0), dtype(dtype), type(type),
+          computed(ComputedFull) {
         assert(size() == 1);
         dataMalloc();
         data[0] = scalar;
     }
     ~Tensor() {
-        if (data != nullptr)
-            delete[] data;
+        assert(numViews == 0);
+        dataFree();
     }
 
     // inputOf and outputOf will not be cloned
@@ -97,6 +115,7 @@ class Tensor {
 
     void replace(Tensor &t) { hash = t.hash; }
     void refresh() { hash = generateHash(); }
+    void setHash(uint64_t h) { hash = h; }
     uint64_t getHash() const { return hash; }
 
     const Dim &getDims() const { return dims; }
@@ -123,10 +142,14 @@ class Tensor {
         splittingPoints.clear();
         hash = generateHash();
         dimPenalty.clear();
+        resetView();
+        if (allocator != nullptr)
+            dataFree();
     }
 
     bool isComputed() const { return computed == ComputedFull; }
     void setComputed() { computed = ComputedFull; }
+    void resetComputed() { computed = NotComputed; }
 
     bool isScalar() const { return dims.empty(); }
 
@@ -162,15 +185,51 @@ class Tensor {
     Operator *getOutputOf() { return outputOf; }
     std::pair<Operator *, int> getOutputOfWithIndex();
 
+    // a view is materialized as the caller is going to write it
     bool dataMalloc() {
+        if (viewBase != nullptr)
+            materialize();
         if (data == nullptr)
-            data = new VType[size()];
+            data = getAllocator()->alloc(size());
         return data != nullptr;
     }
 
-    bool dataRand(int seed = 0) {
+    void dataFree() {
+        resetView();
         if (data == nullptr)
-            data = new VType[size()];
+            return;
+        if (numViews > 0) {
+            std::cout << "[ERROR] Tensor::dataFree: data is read by "
+                      << numViews << " views" << std::endl;
+            return;
+        }
+        getAllocator()->release(data);
+        data = nullptr;
+    }
+
+    // hand the data over to be released by the caller, see
+    // GraphBase::dataFree
+    VType *takeData() {
+        resetView();
+        if (numViews > 0)
+            return nullptr;
+        auto ret = data;
+        data = nullptr;
+        return ret;
+    }
+
+    TensorAllocator *getAllocator() const {
+        return allocator != nullptr ? allocator : &TensorPool::getDefault();
+    }
+    // only for tensors without data
+    void setAllocator(TensorAllocator *allocator_) {
+        assert(data == nullptr);
+        allocator = allocator_;
+    }
+
+    bool dataRand(int seed = 0) {
+        resetView();
+        dataMalloc();
         if (!random_inited)
             initFastrand();
         // srand(seed);
@@ -188,6 +247,10 @@ class Tensor {
     bool setData(VType *dptr) {
         if (dptr == nullptr)
             return false;
+        if (viewBase != nullptr) {
+            resetView();
+            dataMalloc();
+        }
         auto sz = size();
 #pragma omp parallel for
         for (size_t i = 0; i < sz; ++i)
@@ -197,6 +260,8 @@ class Tensor {
     }
 
     bool setScalar(VType val) {
+        if (viewBase != nullptr)
+            materialize();
         if (data == nullptr || !dims.empty())
             return false;
         data[0] = val;
@@ -204,6 +269,8 @@ class Tensor {
     }
 
     bool setData(const Dim &ds, VType val) {
+        if (viewBase != nullptr)
+            materialize();
         if (data == nullptr || ds.size() != dims.size())
             return false;
         data[getOffset(ds)] = val;
@@ -211,27 +278,98 @@ class Tensor {
     }
 
     bool setData(size_t pos, VType val) {
+        if (viewBase != nullptr)
+            materialize();
         if (data == nullptr || pos >= size())
             return false;
         data[pos] = val;
         return true;
     }
 
-    VType getScalar() { return data == nullptr ? 0 : data[0]; }
+    VType getScalar() {
+        if (viewBase != nullptr)
+            return viewBase->data[viewOffset];
+        return data == nullptr ? 0 : data[0];
+    }
 
     VType getData(const Dim &ds) {
-        assert(data != nullptr);
+        assert(data != nullptr || viewBase != nullptr);
         auto offset = getOffset(ds);
-        return offset == (size_t)-1 ? 0 : data[getOffset(ds)];
+        if (offset == (size_t)-1)
+            return 0;
+        return viewBase != nullptr ? viewBase->data[getViewOffset(ds)]
+                                   : data[offset];
     }
 
     VType getData(size_t pos) {
-        assert(data != nullptr);
+        assert(data != nullptr || viewBase != nullptr);
         assert(pos < size());
-        return data[pos];
+        return viewBase != nullptr ? viewBase->data[getViewOffset(pos)]
+                                   : data[pos];
     }
 
-    VType *getDataPtr() const { return data; }
+    // the flat data of a view is only copied out here, tensors shared
+    // between threads are read with getReadPtr instead
+    VType *getDataPtr() {
+        if (viewBase != nullptr)
+            materialize();
+        return data;
+    }
+
+    // the elements are at getReadPtr() with getStrides(), views are read in
+    // place
+    VType *getReadPtr() const {
+        return viewBase != nullptr ? viewBase->data + viewOffset : data;
+    }
+    Dim getStrides() const {
+        return viewBase != nullptr ? viewStrides : denseStrides(dims);
+    }
+    // strides at the positions of a tensor of ds, see getBroadcastOffset
+    Dim getBroadcastStrides(const Dim &ds) const {
+        assert(ds.size() >= dims.size());
+        auto ret = Dim(ds.size() - dims.size(), 0);
+        auto strides = getStrides();
+        ret.insert(ret.end(), strides.begin(), strides.end());
+        return ret;
+    }
+
+    bool isView() const { return viewBase != nullptr; }
+    Tensor *getViewBase() const { return viewBase; }
+    const Dim &getViewStrides() const { return viewStrides; }
+    // make this tensor the box of src starting at begin, src is a computed
+    // tensor or a view of the same dims. Tensors owning data are never made
+    // views, so the base of a view keeps its data.
+    bool setView(Tensor *src, const Dim &begin);
+    // make this tensor src with its own dims, false if src is a view whose
+    // elements are not contiguous
+    bool setReshapeView(Tensor *src);
+    // make this tensor src with dim i read from dim perm[i] of src
+    bool setTransposeView(Tensor *src, const std::vector<int> &perm);
+    // copy the elements of a view into its own data
+    void materialize();
+    void resetView() {
+        if (viewBase != nullptr)
+            viewBase->numViews--;
+        viewBase = nullptr;
+        viewOffset = 0;
+        viewStrides.clear();
+    }
+
+    // offset in the data of viewBase
+    size_t getViewOffset(const Dim &ds) const {
+        size_t ret = viewOffset;
+        for (size_t i = 0, iEnd = ds.size(); i < iEnd; ++i)
+            ret += (size_t)ds[i] * viewStrides[i];
+        return ret;
+    }
+    size_t getViewOffset(size_t pos) const {
+        size_t ret = viewOffset;
+        for (size_t i = dims.size(); i > 0; --i) {
+            ret += pos % dims[i - 1] * viewStrides[i - 1];
+            pos /= dims[i - 1];
+        }
+        return ret;
+    }
 
     size_t getOffset(const Dim &ds) {
         auto nDim = ds.size();
@@ -249,14 +387,14 @@ class Tensor {
     }
 
     VType getBroadcastData(const Dim &ds) {
-        assert(data != nullptr);
+        assert(data != nullptr || viewBase != nullptr);
         auto offset = getBroadcastOffset(ds);
-        return offset == (size_t)-1 ? 0 : data[getOffset(ds)];
+        return offset == (size_t)-1 ? 0 : getData(offset);
     }
 
     VType getBroadcastData(size_t pos) {
-        assert(data != nullptr);
-        return data[pos % size()];
+        assert(data != nullptr || viewBase != nullptr);
+        return getData(pos % size());
     }
 
     size_t getBroadcastOffset(const Dim &ds) {
@@ -320,7 +458,7 @@ class Tensor {
             return;
         }
 
-        if (data == nullptr || dims.size() == 0) {
+        if ((data == nullptr && viewBase == nullptr) || dims.size() == 0) {
             std::cout << "Empty tensor" << std::endl;
             return;
         }
@@ -343,7 +481,7 @@ class Tensor {
                     std::cout << "[";
                 }
             }
-            std::cout << data[i];
+            std::cout << getData(i);
             for (size_t j = 0; j + 1 < numDims; ++j) {
                 if ((int)i % dimSzVec[j] == dimSzVec[j] - 1) {
                     std::cout << "]";
@@ -373,6 +511,9 @@ class Tensor {
         return (g_seed >> 16) & 0x7FFF;
     }
 
+    bool hasSplittingPoints() const { return !splittingPoints.empty(); }
+    void clearSplittingPoints() { splittingPoints.clear(); }
+
     std::vector<std::vector<int>> const *getSplittingPoints() const {
         assert(!splittingPoints.empty());
         return &splittingPoints;
@@ -0,0 +1,61 @@
+#ifndef TENSOR_POOL_H
+#define TENSOR_POOL_H
+
+#include "arena.h"
+#include <map>
+#include <mutex>
+#include <unordered_map>
+
+namespace tpm {
+
+// Size-class pool of tensor buffers. Buffers are 64-byte aligned and
+// rounded up to one of four classes per power of two. Released buffers are
+// kept in the free list of their class, up to maxCached bytes in total.
+// With huge pages, buffers of 2MB and more are 2MB aligned and advised to
+// be backed by huge pages.
+class TensorPool : public TensorAllocator {
+  public:
+    struct Stats {
+        uint64_t allocs = 0, hits = 0, releases = 0;
+        // bytes of the live and the cached buffers
+        size_t used = 0, cached = 0, peak = 0;
+    };
+
+  private:
+    std::mutex mtx;
+    std::map<size_t, std::vector<void *>> freeLists;
+    // class of the live buffers
+    std::unordered_map<void *, size_t> classes;
+    size_t maxCached;
+    bool hugePages;
+    Stats stats;
+
+    void *allocRaw(size_t bytes);
+    void releaseLocked(VType *ptr);
+
+  public:
+    TensorPool(size_t maxCached = 256 << 20, bool hugePages = false)
+        : maxCached(maxCached), hugePages(hugePages) {}
+    TensorPool(const TensorPool &) = delete;
+    TensorPool &operator=(const TensorPool &) = delete;
+    // only the cached buffers are freed
+    ~TensorPool() { trim(); }
+
+    // pool of the tensors without an allocator, configured by
+    // PET_TENSOR_POOL_CACHE=<MB> and PET_HUGE_PAGES=1. It is never
+    // destroyed, as tensors may outlive static objects.
+    static TensorPool &getDefault();
+
+    VType *alloc(size_t size) override;
+    void release(VType *ptr) override;
+    void release(const std::vector<VType *> &ptrs) override;
+    // free the cached buffers
+    void trim();
+
+    Stats getStats();
+    static size_t sizeClass(size_t bytes);
+};
+
+} // end of namespace tpm
+
+#endif // TENSOR_POOL_H
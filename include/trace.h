@@ -0,0 +1,105 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace tpm {
+
+// Collects scoped events and writes them in Chrome trace format, which can
+// be opened in chrome://tracing or Perfetto. Tracing is enabled by setting
+// PET_TRACE_FILE or calling enable(), and the file is written on dump() or
+// at exit.
+class TraceEngine { // Singleton Pattern
+  public:
+    using Args = std::vector<std::pair<std::string, std::string>>;
+
+  private:
+    struct Event {
+        std::string name;
+        int tid;
+        int64_t ts, dur;
+        Args args;
+    };
+    bool enabled;
+    std::string path;
+    std::mutex mtx;
+    std::vector<Event> events;
+    std::chrono::steady_clock::time_point start;
+
+    TraceEngine();
+    ~TraceEngine();
+    TraceEngine(const TraceEngine &) = delete;
+    TraceEngine &operator=(const TraceEngine &) = delete;
+
+  public:
+    static TraceEngine &getInstance() {
+        static TraceEngine instance;
+        return instance;
+    }
+
+    bool isEnabled() const { return enabled; }
+    void enable(const std::string &path_) {
+        path = path_;
+        enabled = true;
+    }
+    void disable() { enabled = false; }
+    // microseconds since the engine was created
+    int64_t now() const {
+        return std::chrono::duration_cast<std::chrono::microseconds>(
+                   std::chrono::steady_clock::now() - start)
+            .count();
+    }
+    // small sequential id of the calling thread
+    static int threadId();
+
+    void addEvent(const std::string &name, int64_t ts, int64_t dur,
+                  Args &&args);
+    void clear();
+    int dump() { return dump(path); }
+    int dump(const std::string &file);
+};
+
+// Records one complete event from construction to destruction.
+// Arguments are only formatted when tracing is enabled.
+class TraceScope {
+    const char *name;
+    bool active;
+    int64_t ts;
+    TraceEngine::Args args;
+
+  public:
+    TraceScope(const char *name_, bool cond = true)
+        : name(name_), active(cond && TraceEngine::getInstance().isEnabled()),
+          ts(0) {
+        if (active)
+            ts = TraceEngine::getInstance().now();
+    }
+    ~TraceScope() {
+        if (!active)
+            return;
+        auto &engine = TraceEngine::getInstance();
+        engine.addEvent(name, ts, engine.now() - ts, std::move(args));
+    }
+    TraceScope(const TraceScope &) = delete;
+    TraceScope &operator=(const TraceScope &) = delete;
+
+    bool isActive() const { return active; }
+    template <class T> TraceScope &arg(const std::string &key, const T &val) {
+        if (active) {
+            std::ostringstream os;
+            os << val;
+            args.emplace_back(key, os.str());
+        }
+        return *this;
+    }
+};
+
+} // end of namespace tpm
+
+#endif // TRACE_H
@@ -0,0 +1,58 @@
+#include "arena.h"
+
+namespace tpm {
+
+VType *TensorArena::alloc(size_t size) {
+    size = std::max(size, (size_t)1);
+    if (curChunk >= chunks.size() || curOffset + size > chunkSizes[curChunk]) {
+        // the current chunk is full, move to the next one. Chunks above the
+        // top are unused and can be replaced if they are too small.
+        if (curChunk < chunks.size() && curOffset > 0)
+            ++curChunk;
+        if (curChunk < chunks.size() && chunkSizes[curChunk] < size) {
+            chunks.erase(chunks.begin() + curChunk);
+            chunkSizes.erase(chunkSizes.begin() + curChunk);
+        }
+        if (curChunk >= chunks.size() || chunkSizes[curChunk] < size) {
+            auto sz = std::max(chunkSize, size);
+            chunks.emplace(chunks.begin() + curChunk, new VType[sz]);
+            chunkSizes.emplace(chunkSizes.begin() + curChunk, sz);
+        }
+        curOffset = 0;
+    }
+    blocks.emplace_back(Block{curChunk, curOffset, size, false});
+    auto ptr = chunks[curChunk].get() + curOffset;
+    curOffset += size;
+    used += size;
+    peak = std::max(peak, used);
+    return ptr;
+}
+
+void TensorArena::release(VType *ptr) {
+    for (size_t i = blocks.size(); i-- > 0;) {
+        auto &b = blocks[i];
+        if (b.released || chunks[b.chunk].get() + b.offset != ptr)
+            continue;
+        b.released = true;
+        used -= b.size;
+        break;
+    }
+    while (!blocks.empty() && blocks.back().released)
+        blocks.pop_back();
+    if (blocks.empty()) {
+        curChunk = 0;
+        curOffset = 0;
+    } else {
+        curChunk = blocks.back().chunk;
+        curOffset = blocks.back().offset + blocks.back().size;
+    }
+}
+
+size_t TensorArena::getCapacity() const {
+    size_t ret = 0;
+    for (auto sz : chunkSizes)
+        ret += sz;
+    return ret;
+}
+
+} // end of namespace tpm
@@ -0,0 +1,153 @@
+#include "cpu_kernel.h"
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define TPM_X86
+#endif
+
+namespace tpm {
+
+namespace cpu {
+
+// c[i] += a * b[i]
+using AxpyFunc = void (*)(VType *c, const VType *b, VType a, int n);
+
+static void axpyScalar(VType *c, const VType *b, VType a, int n) {
+    for (int i = 0; i < n; ++i)
+        c[i] += a * b[i];
+}
+
+#ifdef TPM_X86
+__attribute__((target("avx2"))) static void axpyAvx2(VType *c, const VType *b,
+                                                     VType a, int n) {
+    auto va = _mm256_set1_epi32(a);
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        auto vb = _mm256_loadu_si256((const __m256i *)(b + i));
+        auto vc = _mm256_loadu_si256((const __m256i *)(c + i));
+        vc = _mm256_add_epi32(vc, _mm256_mullo_epi32(va, vb));
+        _mm256_storeu_si256((__m256i *)(c + i), vc);
+    }
+    for (; i < n; ++i)
+        c[i] += a * b[i];
+}
+
+__attribute__((target("avx512f"))) static void
+axpyAvx512(VType *c, const VType *b, VType a, int n) {
+    auto va = _mm512_set1_epi32(a);
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        auto vb = _mm512_loadu_si512((const void *)(b + i));
+        auto vc = _mm512_loadu_si512((const void *)(c + i));
+        vc = _mm512_add_epi32(vc, _mm512_mullo_epi32(va, vb));
+        _mm512_storeu_si512((void *)(c + i), vc);
+    }
+    for (; i < n; ++i)
+        c[i] += a * b[i];
+}
+#endif
+
+struct Isa {
+    AxpyFunc axpy;
+    const char *name;
+};
+
+// PET_CPU_ISA=scalar/avx2 limits the vector path, e.g. for comparisons
+static Isa selectIsa() {
+    auto env = getenv("PET_CPU_ISA");
+    std::string limit = env == nullptr ? "" : env;
+#ifdef TPM_X86
+    __builtin_cpu_init();
+    if (limit.empty() && __builtin_cpu_supports("avx512f"))
+        return {axpyAvx512, "avx512"};
+    if ((limit.empty() || limit == "avx2") && __builtin_cpu_supports("avx2"))
+        return {axpyAvx2, "avx2"};
+#endif
+    return {axpyScalar, "scalar"};
+}
+
+static const Isa &getIsa() {
+    static Isa isa = selectIsa();
+    return isa;
+}
+
+const char *isaName() { return getIsa().name; }
+
+// block sizes in elements: a KC x NC block of B stays in L2 while MC rows of
+// C are updated
+static const int MC = 16, KC = 256, NC = 512;
+
+void gemm(int m, int n, int k, const VType *A, size_t rsA, size_t csA,
+          const VType *B, size_t ldb, VType *C, size_t ldc, bool parallel) {
+    auto axpy = getIsa().axpy;
+    int mBlocks = (m + MC - 1) / MC;
+#pragma omp parallel for schedule(dynamic) if (parallel && mBlocks > 1)
+    for (int mb = 0; mb < mBlocks; ++mb) {
+        int i0 = mb * MC, i1 = std::min(m, i0 + MC);
+        for (int i = i0; i < i1; ++i)
+            memset(C + i * ldc, 0, sizeof(VType) * n);
+        for (int k0 = 0; k0 < k; k0 += KC) {
+            int k1 = std::min(k, k0 + KC);
+            for (int j0 = 0; j0 < n; j0 += NC) {
+                int nj = std::min(n - j0, NC);
+                for (int i = i0; i < i1; ++i) {
+                    auto crow = C + i * ldc + j0;
+                    auto arow = A + i * rsA;
+                    for (int kk = k0; kk < k1; ++kk) {
+                        auto a = arow[kk * csA];
+                        if (a != 0)
+                            axpy(crow, B + kk * ldb + j0, a, nj);
+                    }
+                }
+            }
+        }
+    }
+}
+
+void im2col(const VType *input, int h, int w, int c0, int nc, int r, int s,
+            int ph, int pw, int sh, int sw, int dh, int dw, int ow, int p0,
+            int np, VType *col) {
+    int rows = nc * r * s;
+#pragma omp parallel for if (rows > 1)
+    for (int row = 0; row < rows; ++row) {
+        int ss = row % s, rr = row / s % r, cc = c0 + row / (r * s);
+        auto plane = input + (size_t)cc * h * w;
+        auto dst = col + (size_t)row * np;
+        // walk output pixels one output row at a time, so the padding at
+        // both ends is cut off before the copy loop
+        for (int p = 0; p < np;) {
+            int hh = (p0 + p) / ow, ww = (p0 + p) % ow;
+            int len = std::min(ow - ww, np - p);
+            int posH = hh * sh + rr * dh - ph;
+            if (posH < 0 || posH >= h) {
+                memset(dst + p, 0, sizeof(VType) * len);
+                p += len;
+                continue;
+            }
+            // valid ww satisfy 0 <= ww * sw + ss * dw - pw < w
+            int off = ss * dw - pw;
+            int lo = off >= 0 ? 0 : (-off + sw - 1) / sw;
+            int hi = w - off <= 0 ? 0 : (w - off + sw - 1) / sw;
+            lo = std::min(std::max(lo, ww), ww + len);
+            hi = std::min(std::max(hi, lo), ww + len);
+            auto src = plane + (size_t)posH * w;
+            auto out = dst + p - ww;
+            for (int x = ww; x < lo; ++x)
+                out[x] = 0;
+            if (sw == 1)
+                memcpy(out + lo, src + lo + off, sizeof(VType) * (hi - lo));
+            else
+                for (int x = lo; x < hi; ++x)
+                    out[x] = src[x * sw + off];
+            for (int x = hi; x < ww + len; ++x)
+                out[x] = 0;
+            p += len;
+        }
+    }
+}
+
+} // namespace cpu
+
+} // end of namespace tpm
@@ -0,0 +1,190 @@
+#include "dim.h"
+#include <cstdlib>
+
+namespace tpm {
+
+DimRange::DimRange(const Dim &begin, const Dim &end, const Dim &step)
+    : DimRange(begin, end) {
+    if (state != RangePos || step.empty())
+        return;
+    if (step.size() != begin.size()) {
+        state = Invalid;
+        return;
+    }
+    bool dense = true;
+    for (size_t i = 0, iEnd = step.size(); i < iEnd; ++i) {
+        if (step[i] < 1) {
+            state = Invalid;
+            return;
+        }
+        this->end[i] -= (this->end[i] - begin[i]) % step[i];
+        if (this->end[i] > begin[i] && step[i] > 1)
+            dense = false;
+    }
+    if (this->begin == this->end) {
+        state = SinglePos;
+        return;
+    }
+    if (dense)
+        return;
+    this->step = step;
+    for (size_t i = 0, iEnd = step.size(); i < iEnd; ++i)
+        if (this->end[i] == begin[i])
+            this->step[i] = 1;
+}
+
+DimRange DimRange::getBoxList(const std::vector<DimRange> &boxes) {
+    if (boxes.empty())
+        return getEmpty();
+    if (boxes.size() == 1)
+        return boxes[0];
+    DimRange ret(BoxList);
+    ret.begin = boxes[0].begin;
+    ret.end = boxes[0].end;
+    for (auto &box : boxes) {
+        if (!box.isBox())
+            return getInvalid();
+        ret.begin = elementwiseMin(ret.begin, box.begin);
+        ret.end = elementwiseMax(ret.end, box.end);
+    }
+    ret.boxes = boxes;
+    return ret;
+}
+
+size_t DimRange::size() const {
+    if (state == BoxList) {
+        size_t ret = 0;
+        for (auto &box : boxes)
+            ret += box.size();
+        return ret;
+    }
+    if (!isBox())
+        return 0;
+    size_t ret = 1;
+    for (size_t i = 0, iEnd = begin.size(); i < iEnd; ++i)
+        ret *= (end[i] - begin[i]) / getStep(i) + 1;
+    return ret;
+}
+
+bool DimRange::covers(const DimRange &rhs) const {
+    if (!isBox() || !rhs.isBox() || begin.size() != rhs.begin.size())
+        return false;
+    for (size_t i = 0, iEnd = begin.size(); i < iEnd; ++i) {
+        if (rhs.begin[i] < begin[i] || rhs.end[i] > end[i] ||
+            (rhs.begin[i] - begin[i]) % getStep(i) != 0)
+            return false;
+        if (rhs.end[i] > rhs.begin[i] && rhs.getStep(i) % getStep(i) != 0)
+            return false;
+    }
+    return true;
+}
+
+DimRange clipRange(Dim begin, Dim end, const Dim &dims, const Dim &step) {
+    for (size_t i = 0, iEnd = dims.size(); i < iEnd; ++i) {
+        int st = step.empty() ? 1 : step[i];
+        // the first position of the box in the tensor
+        if (begin[i] < 0)
+            begin[i] += (-begin[i] + st - 1) / st * st;
+        end[i] = std::min(end[i], dims[i] - 1);
+        if (begin[i] > end[i])
+            return DimRange::getEmpty();
+    }
+    return DimRange(begin, end, step);
+}
+
+static int gcd(int a, int b) { return b == 0 ? a : gcd(b, a % b); }
+
+// a box holding exactly the positions of both boxes, or an invalid range
+static DimRange mergeBoxes(const DimRange &lhs, const DimRange &rhs) {
+    if (lhs.covers(rhs))
+        return lhs;
+    if (rhs.covers(lhs))
+        return rhs;
+    auto &lb = lhs.getBegin(), &le = lhs.getEnd();
+    auto &rb = rhs.getBegin(), &re = rhs.getEnd();
+    // the boxes may only differ in one dim
+    int d = -1;
+    for (size_t i = 0, iEnd = lb.size(); i < iEnd; ++i) {
+        if (lb[i] == rb[i] && le[i] == re[i] &&
+            lhs.getStep(i) == rhs.getStep(i))
+            continue;
+        if (d >= 0)
+            return DimRange::getInvalid();
+        d = i;
+    }
+    // positions along d must stay evenly spaced
+    int st;
+    if (lb[d] == le[d] && rb[d] == re[d])
+        st = std::abs(rb[d] - lb[d]);
+    else if (lb[d] == le[d])
+        st = rhs.getStep(d);
+    else if (rb[d] == re[d] || lhs.getStep(d) == rhs.getStep(d))
+        st = lhs.getStep(d);
+    else
+        return DimRange::getInvalid();
+    if ((rb[d] - lb[d]) % st != 0 || rb[d] > le[d] + st || lb[d] > re[d] + st)
+        return DimRange::getInvalid();
+    auto begin = lb, end = le, step = lhs.getStep();
+    if (step.empty())
+        step = Dim(lb.size(), 1);
+    begin[d] = std::min(lb[d], rb[d]);
+    end[d] = std::max(le[d], re[d]);
+    step[d] = st;
+    return DimRange(begin, end, step);
+}
+
+// the box bounding all the boxes, strided by the gcd of their offsets
+static DimRange boundBoxes(const std::vector<DimRange> &boxes) {
+    auto begin = boxes[0].getBegin(), end = boxes[0].getEnd();
+    for (auto &box : boxes) {
+        begin = elementwiseMin(begin, box.getBegin());
+        end = elementwiseMax(end, box.getEnd());
+    }
+    Dim step(begin.size(), 0);
+    for (auto &box : boxes)
+        for (size_t i = 0, iEnd = begin.size(); i < iEnd; ++i) {
+            step[i] = gcd(step[i], box.getBegin()[i] - begin[i]);
+            if (box.getEnd()[i] > box.getBegin()[i])
+                step[i] = gcd(step[i], box.getStep(i));
+        }
+    for (auto &st : step)
+        st = std::max(st, 1);
+    return DimRange(begin, end, step);
+}
+
+DimRange unionRange(const DimRange &lhs, const DimRange &rhs,
+                    size_t maxBoxes) {
+    if (lhs.notValid() || rhs.notValid()) {
+        return DimRange::getInvalid();
+    }
+    if (lhs.isAllPos() || rhs.isAllPos()) {
+        return DimRange::getAllPos();
+    }
+    if (lhs.isEmpty()) {
+        return DimRange(rhs);
+    }
+    if (rhs.isEmpty()) {
+        return DimRange(lhs);
+    }
+    auto boxes = lhs.isBoxList() ? lhs.getBoxes() : std::vector<DimRange>{lhs};
+    auto rhsBoxes =
+        rhs.isBoxList() ? rhs.getBoxes() : std::vector<DimRange>{rhs};
+    for (auto &box : rhsBoxes) {
+        bool merged = false;
+        for (auto &cur : boxes) {
+            auto ret = mergeBoxes(cur, box);
+            if (ret.valid()) {
+                cur = ret;
+                merged = true;
+                break;
+            }
+        }
+        if (!merged)
+            boxes.emplace_back(box);
+    }
+    if (boxes.size() > maxBoxes)
+        return boundBoxes(boxes);
+    return DimRange::getBoxList(boxes);
+}
+
+} // end of namespace tpm
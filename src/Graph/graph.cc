@@ -3,6 +3,7 @@
 #include "ffi.h"
 #include "operator.h"
 #include "tensor.h"
+#include <set>
 #include <string>
 #include <unordered_map>
 #include <unordered_set>
@@ -129,6 +130,7 @@ PYBIND11_EMBEDDED_MODULE(cpp_module, m) {
 }
 
 GraphBase::~GraphBase() {
+    dataFree();
     for (auto op : ops)
         if (op != nullptr)
             delete op;
@@ -137,6 +139,23 @@ GraphBase::~GraphBase() {
             delete tensor;
 }
 
+void GraphBase::dataFree() {
+    std::map<TensorAllocator *, std::vector<VType *>> buffers;
+    // views are dropped without being materialized, before their bases
+    for (auto tensor : tensors)
+        if (tensor != nullptr)
+            tensor->resetView();
+    for (auto tensor : tensors) {
+        if (tensor == nullptr)
+            continue;
+        auto data = tensor->takeData();
+        if (data != nullptr)
+            buffers[tensor->getAllocator()].emplace_back(data);
+    }
+    for (auto &item : buffers)
+        item.first->release(item.second);
+}
+
 void GraphBase::addTensor(Tensor *tensor) { tensors.emplace_back(tensor); }
 
 TensorVec &GraphBase::getTensors() { return tensors; }
@@ -718,126 +737,248 @@ SubGraph::compute(const Dim &point, size_t outputId, bool getAllPos) const {
     if (outputId >= outputs.size()) {
         return {false, 0};
     }
+    ComputePlan plan(this, outputId);
+    if (!plan.run(getAllPos ? DimRange::getAllPos() : DimRange(point)))
+        return {false, 0};
+    return {true, outputs[outputId]->getData(point)};
+}
 
-    std::unordered_map<const Tensor *, DimRange> drs;
+ComputePlan::ComputePlan(const SubGraph *graph, size_t outputId)
+    : outputId(outputId), valid(false), target(nullptr) {
+    auto &outputs = graph->getOutputs();
+    if (outputId >= outputs.size())
+        return;
+    std::unordered_map<const Tensor *, size_t> tensorIds;
+    auto getId = [&tensorIds](const Tensor *t) {
+        return tensorIds.emplace(t, tensorIds.size()).first->second;
+    };
     for (auto output : outputs)
-        drs[output] = DimRange::getEmpty();
-    if (getAllPos)
-        drs[outputs[outputId]] = DimRange::getAllPos();
-    else
-        drs[outputs[outputId]] = DimRange(point);
+        graphOutputIds.emplace_back(getId(output));
+    target = outputs[outputId];
 
     // reversed DFS post-order is topo-order
     std::unordered_set<const Operator *> flag;
-    // computing functions for operators
-    std::vector<std::function<bool()>> runners;
-    std::function<bool(Operator *)> dfs = [&](Operator *op) -> bool {
-        if (flag.count(op)) {
-            return true;
-        }
+    std::function<void(Operator *)> dfs = [&](Operator *op) {
+        if (flag.count(op))
+            return;
         flag.insert(op);
-        for (auto &&next : op->getSuccessors()) {
-            if (!dfs(next)) {
-                return false;
-            }
-        }
+        for (auto &&next : op->getSuccessors())
+            dfs(next);
+        order.emplace_back(op);
+    };
+    for (auto &&op : graph->getOperators())
+        dfs(op);
+
+    for (auto op : order) {
+        outputIds.emplace_back();
+        for (auto t : op->getOutputs())
+            outputIds.back().emplace_back(getId(t));
+        inputIds.emplace_back();
+        for (auto t : op->getInputs())
+            inputIds.back().emplace_back(getId(t));
+    }
+    drs.resize(tensorIds.size());
+    hasDr.resize(tensorIds.size());
+    runners.reserve(order.size());
+    valid = true;
+}
 
-        std::vector<DimRange> inDrs;
-        std::function<bool()> runner;
-        Tensor *out = op->getOutput();
-        if (out != nullptr) {
-            std::tie(inDrs, runner) = op->compute(drs.at(out));
-            if (runner == nullptr) {
-                return false;
+bool ComputePlan::run(const DimRange &dr) {
+    if (!valid)
+        return false;
+    std::fill(hasDr.begin(), hasDr.end(), 0);
+    for (auto id : graphOutputIds) {
+        drs[id] = DimRange::getEmpty();
+        hasDr[id] = 1;
+    }
+    drs[graphOutputIds[outputId]] = dr;
+
+    runners.clear();
+    for (size_t i = 0, iEnd = order.size(); i < iEnd; ++i) {
+        auto op = order[i];
+        // every consumer is visited before the producer, a split computes
+        // each of its outputs that is read
+        for (size_t k = 0, kEnd = outputIds[i].size(); k < kEnd; ++k) {
+            auto out = outputIds[i][k];
+            assert(hasDr[out] || op->isSplitOp());
+            if (!hasDr[out])
+                continue;
+            // scratch tensors of the search get their data lazily, so each
+            // output read by a consumer is allocated before any runner
+            if (!drs[out].isEmpty())
+                op->getOutputs()[k]->dataMalloc();
+            // ops compute the boxes of a box list one by one
+            if (drs[out].isBoxList())
+                boxes = drs[out].getBoxes();
+            else
+                boxes.assign(1, drs[out]);
+            for (auto &box : boxes) {
+                std::function<bool()> runner;
+                if (op->isSplitOp())
+                    std::tie(inDrs, runner) =
+                        dynamic_cast<SplitOp *>(op)->compute(k, box);
+                else
+                    std::tie(inDrs, runner) = op->compute(box);
+                if (runner == nullptr)
+                    return false;
+                assert(op->isConcatOp() ||
+                       (int)inDrs.size() == op->numInputs());
+                auto &ids = inputIds[i];
+                for (size_t j = 0, jEnd = inDrs.size(); j < jEnd; j++) {
+                    auto t = ids[j];
+                    drs[t] =
+                        hasDr[t] ? unionRange(drs[t], inDrs[j]) : inDrs[j];
+                    hasDr[t] = 1;
+                }
+                runners.emplace_back(std::move(runner));
             }
-        } else {
-            assert(op->isSplitOp());
-            out = op->getOutputs()[outputId];
-            std::tie(inDrs, runner) =
-                dynamic_cast<SplitOp *>(op)->compute(outputId, drs.at(out));
-        }
-        assert(op->isConcatOp() || (int)inDrs.size() == op->numInputs());
-        for (size_t i = 0, iEnd = inDrs.size(); i < iEnd; i++) {
-            const Tensor *t = op->getInputs()[i];
-            drs[t] = drs.count(t) ? unionRange(drs[t], inDrs[i]) : inDrs[i];
-        }
-        runners.push_back(runner);
-        return true;
-    };
-    // Operator *op = outputs[outputId]->getOutputOf();
-    for (auto &&op : ops) {
-        if (!dfs(op)) {
-            return {false, 0};
         }
     }
 
     for (auto it = runners.rbegin(); it != runners.rend(); it++) {
         if (!(*it)()) {
-            return {false, 0};
+            return false;
         }
     }
-    return {true, outputs[outputId]->getData(point)};
+    return true;
+}
+
+bool ComputePlan::compute(const Dim &point, VType &value) {
+    if (!run(DimRange(point)))
+        return false;
+    value = target->getData(point);
+    return true;
+}
+
+bool ComputePlan::compute(const std::vector<Dim> &points,
+                          std::vector<VType> &values) {
+    values.clear();
+    if (points.empty())
+        return true;
+    // one run computes all points, each op then unions the regions its
+    // consumers read. The points are not merged into larger boxes, which most
+    // ops would compute in full.
+    std::set<Dim> seen;
+    std::vector<DimRange> pointBoxes;
+    for (auto &point : points)
+        if (seen.insert(point).second)
+            pointBoxes.emplace_back(point);
+    if (!run(DimRange::getBoxList(pointBoxes)))
+        return false;
+    for (auto &point : points)
+        values.emplace_back(target->getData(point));
+    return true;
 }
 
 uint64_t SubGraph::getHash() {
-    if (hash != 2147483647) {
-        return hash;
+    if (hash == 2147483647)
+        hash = computeHash(false);
+    return hash;
+}
+
+uint64_t SubGraph::getCanonicalHash() { return computeHash(true); }
+
+static uint64_t tensorLabel(const Tensor *t) {
+    uint64_t ret = hashCombine(t->getType(), t->getDType());
+    for (auto d : t->getDims())
+        ret = hashCombine(ret, d);
+    return ret;
+}
+
+// Every op label is refined from the labels of its inputs in topological
+// order, which is a Weisfeiler-Lehman round that already converges on a DAG.
+// Graph inputs are labelled by their tensor hash for the hash. For the
+// canonical hash they are labelled by shape and type, then by the ops and
+// slots reading them, so that add(x, x) and add(x, y) or a weight shared by
+// two ops and two equal weights get different labels.
+uint64_t SubGraph::computeHash(bool canonical) {
+    auto &opList = getOperators();
+    std::unordered_map<const Operator *, int> nodeMap;
+    for (size_t i = 0; i < opList.size(); i++)
+        nodeMap.emplace(opList[i], i);
+    auto isInput = [&nodeMap](Tensor *t) {
+        auto prev = t->getOutputOf();
+        return prev == nullptr || nodeMap.find(prev) == nodeMap.end();
+    };
+    std::unordered_map<const Tensor *, uint64_t> inputLabels;
+    for (auto op : opList)
+        for (auto t : op->getInputs())
+            if (isInput(t))
+                inputLabels[t] = canonical ? tensorLabel(t) : t->getHash();
+    auto nodeHash = refineLabels(nodeMap, inputLabels);
+    if (canonical) {
+        std::unordered_map<const Tensor *, std::vector<uint64_t>> uses;
+        for (size_t i = 0; i < opList.size(); i++) {
+            auto &inputs = opList[i]->getInputs();
+            for (size_t j = 0; j < inputs.size(); j++)
+                if (isInput(inputs[j]))
+                    uses[inputs[j]].emplace_back(hashCombine(nodeHash[i], j));
+        }
+        for (auto &kv : uses) {
+            std::sort(kv.second.begin(), kv.second.end());
+            for (auto use : kv.second)
+                inputLabels[kv.first] = hashCombine(inputLabels[kv.first], use);
+        }
+        nodeHash = refineLabels(nodeMap, inputLabels);
     }
-    // TODO: Replace string operations with int operations
+
+    // fold all op labels independent of the op order, then the outputs in
+    // order since they match the outputs of other graphs by position
+    std::vector<uint64_t> labels(nodeHash);
+    std::sort(labels.begin(), labels.end());
+    uint64_t ret = opList.size();
+    for (auto l : labels)
+        ret = hashCombine(ret, l);
+    for (auto t : getOutputs()) {
+        auto it = nodeMap.find(t->getOutputOf());
+        ret = hashCombine(ret, it == nodeMap.end() ? 0 : nodeHash[it->second]);
+        if (!canonical)
+            ret = hashCombine(ret, t->getHash());
+    }
+    return ret;
+}
+
+std::vector<uint64_t> SubGraph::refineLabels(
+    const std::unordered_map<const Operator *, int> &nodeMap,
+    const std::unordered_map<const Tensor *, uint64_t> &inputLabels) {
     auto &opList = getOperators();
     std::vector<int> cnt(opList.size());
     std::vector<uint64_t> nodeHash(opList.size());
-    std::unordered_map<int, int> nodeMap;
-    std::unordered_set<int> inputSet;
     std::vector<int> q;
     for (size_t i = 0; i < opList.size(); i++) {
         auto &op = opList[i];
-        nodeMap.emplace(op->getGuid(), i);
         cnt[i] = op->getPredecessors().size();
-        nodeHash[i] = hashPack(op->getHash());
-    }
-    for (auto t : getInputs()) {
-        inputSet.emplace(t->getGuid());
-    }
-    for (size_t i = 0; i < opList.size(); i++) {
-        auto &op = opList[i];
-        if (op->getPredecessors().size() == 0) {
+        nodeHash[i] = hashCombine(op->getType(), op->getHash());
+        for (auto t : op->getOutputs())
+            nodeHash[i] = hashCombine(nodeHash[i], tensorLabel(t));
+        if (cnt[i] == 0)
             q.emplace_back(i);
-        }
     }
 
-    int st = 0, ed = q.size();
-    while (st < ed) {
+    for (size_t st = 0; st < q.size(); st++) {
         int id = q[st];
-        st++;
         auto &op = opList[id];
         for (auto t : op->getInputs()) {
-            if (inputSet.find(t->getGuid()) != inputSet.end()) {
-                nodeHash[id] = hashAppend(nodeHash[id], t->getHash());
-            } else {
-                nodeHash[id] =
-                    hashAppend(nodeHash[id],
-                               nodeHash[nodeMap[t->getOutputOf()->getGuid()]]);
+            auto prev = t->getOutputOf();
+            auto it = prev == nullptr ? nodeMap.end() : nodeMap.find(prev);
+            if (it == nodeMap.end()) {
+                nodeHash[id] = hashCombine(nodeHash[id], inputLabels.at(t));
+                continue;
             }
+            auto &prevOutputs = prev->getOutputs();
+            auto idx = std::find(prevOutputs.begin(), prevOutputs.end(), t) -
+                       prevOutputs.begin();
+            nodeHash[id] =
+                hashCombine(nodeHash[id], hashCombine(nodeHash[it->second], idx));
         }
-        nodeHash[id] = hashPack(nodeHash[id]);
         for (auto suc : op->getSuccessors()) {
-            int suc_id = nodeMap[suc->getGuid()];
+            int suc_id = nodeMap.at(suc);
             cnt[suc_id]--;
-            if (cnt[suc_id] == 0) {
+            if (cnt[suc_id] == 0)
                 q.emplace_back(suc_id);
-                ed++;
-            }
         }
     }
-
-    hash = 0;
-    for (auto t : getOutputs()) {
-        int id = nodeMap[t->getOutputOf()->getGuid()];
-        hash =
-            hashAppend(hash, hashPack(hashAppend(t->getHash(), nodeHash[id])));
-    }
-    return hash;
+    return nodeHash;
 }
 
 int SubGraph::print() {
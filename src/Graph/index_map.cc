@@ -0,0 +1,126 @@
+#include "index_map.h"
+#include "operator.h"
+#include "tensor.h"
+
+namespace tpm {
+
+IndexMap::IndexMap(const Tensor *tensor) : source(tensor->getHash()) {
+    auto &shape = tensor->getDims();
+    int64_t stride = 1;
+    dims.resize(shape.size());
+    for (int i = (int)shape.size() - 1; i >= 0; --i) {
+        dims[i].push_back({stride, shape[i]});
+        stride *= shape[i];
+    }
+}
+
+// Split digits of a dim into an outer part and an inner part of size
+// innerSize. A digit crossing the boundary is cut in two if its radix
+// allows it.
+static bool splitDigits(const std::vector<IndexMap::Digit> &digits,
+                        int innerSize, std::vector<IndexMap::Digit> &outer,
+                        std::vector<IndexMap::Digit> &inner) {
+    outer = digits;
+    inner.clear();
+    int rem = innerSize;
+    while (rem > 1) {
+        if (outer.empty())
+            return false;
+        auto d = outer.back();
+        if (rem % d.radix == 0) {
+            inner.insert(inner.begin(), d);
+            outer.pop_back();
+            rem /= d.radix;
+        } else if (d.radix % rem == 0) {
+            inner.insert(inner.begin(), {d.stride, rem});
+            outer.back() = {d.stride * rem, d.radix / rem};
+            rem = 1;
+        } else
+            return false;
+    }
+    return true;
+}
+
+bool IndexMap::apply(const TransposeOp *op) {
+    auto &before = op->getBefore();
+    auto &after = op->getAfter();
+    int factor = op->getFactor();
+    if (before.size() != dims.size())
+        return false;
+    std::vector<std::vector<Digit>> flat;
+    auto shape = getDims();
+    for (size_t i = 0, iEnd = before.size(); i < iEnd; ++i) {
+        if (before[i].isSingle()) {
+            flat.emplace_back(dims[i]);
+            continue;
+        }
+        if (factor == 0 || shape[i] % std::abs(factor) != 0)
+            return false;
+        int innerSize = factor > 0 ? factor : shape[i] / (-factor);
+        std::vector<Digit> outer, inner;
+        if (!splitDigits(dims[i], innerSize, outer, inner))
+            return false;
+        flat.emplace_back(outer);
+        flat.emplace_back(inner);
+    }
+    std::vector<std::vector<Digit>> ret;
+    for (size_t i = 0, iEnd = after.size(); i < iEnd; ++i) {
+        ret.emplace_back();
+        for (auto pos : after[i].getVec()) {
+            if (pos < 0 || pos >= (int)flat.size())
+                return false;
+            ret.back().insert(ret.back().end(), flat[pos].begin(),
+                              flat[pos].end());
+        }
+    }
+    dims = std::move(ret);
+    return true;
+}
+
+Dim IndexMap::getDims() const {
+    Dim ret;
+    for (auto &digits : dims) {
+        int sz = 1;
+        for (auto &d : digits)
+            sz *= d.radix;
+        ret.emplace_back(sz);
+    }
+    return ret;
+}
+
+std::vector<IndexMap::Digit> IndexMap::canonical() const {
+    std::vector<Digit> ret;
+    for (auto &digits : dims)
+        for (auto &d : digits) {
+            if (d.radix == 1)
+                continue;
+            if (!ret.empty() && ret.back().stride == d.stride * d.radix)
+                ret.back() = {d.stride, ret.back().radix * d.radix};
+            else
+                ret.emplace_back(d);
+        }
+    return ret;
+}
+
+bool IndexMap::operator==(const IndexMap &rhs) const {
+    return source == rhs.source && getDims() == rhs.getDims() &&
+           canonical() == rhs.canonical();
+}
+
+bool IndexMap::fromTensor(Tensor *tensor, IndexMap &map) {
+    auto op = tensor->getOutputOf();
+    if (op == nullptr) {
+        map = IndexMap(tensor);
+        return true;
+    }
+    if (op->getType() != Operator::Transpose &&
+        op->getType() != Operator::Identity)
+        return false;
+    if (!fromTensor(op->getInputs()[0], map))
+        return false;
+    if (op->isTransposeOp())
+        return map.apply((const TransposeOp *)op);
+    return true;
+}
+
+} // end of namespace tpm
@@ -1,7 +1,9 @@
 #include "operator.h"
 #include "common.h"
+#include "cpu_kernel.h"
 #include "graph.h"
 #include "perf_engine.h"
+#include "strided_loop.h"
 #include "tensor.h"
 #include <chrono>
 #include <cstdlib>
@@ -111,44 +113,23 @@ Tensor *ConvOp::compute() {
     auto oh = outDim[2], ow = outDim[3];
     auto iptr = input->getDataPtr(), wptr = weight->getDataPtr(),
          optr = output->getDataPtr();
+    // im2col + gemm per image and group. Output pixels are tiled so that the
+    // gathered input stays around 16MB.
+    int fpg = f / g, K = cpg * r * s, pixels = oh * ow;
+    int tile = std::max(1, std::min(pixels, (1 << 22) / std::max(K, 1)));
+    std::vector<VType> col((size_t)K * tile);
     for (int nn = 0; nn < n; nn++) {
-#pragma omp parallel for
-        for (int ff = 0; ff < f; ff++) {
-            for (int hh = 0; hh < oh; hh++)
-                for (int ww = 0; ww < ow; ww++) {
-                    int gidx = ff / (f / g);
-                    VType val = 0;
-                    for (int cc = 0; cc < cpg; cc++)
-                        for (int rr = 0; rr < r; rr++)
-                            for (int ss = 0; ss < s; ss++) {
-                                int posH = hh * sh + rr * dh - ph;
-                                int posW = ww * sw + ss * dw - pw;
-                                // VType weightVal =
-                                //     weight->getData({ff, cc, rr, ss});
-                                // VType inputVal = input->getData(
-                                //     {nn, cc + gidx * cpg, posH, posW});
-                                if (posH < 0 || posH >= h || posW < 0 ||
-                                    posW >= w)
-                                    continue;
-                                auto iOffset =
-                                         posW +
-                                         w * (posH +
-                                              h * ((cc + gidx * cpg) + c * nn)),
-                                     wOffset =
-                                         ss + s * (rr + r * (cc + cpg * ff));
-                                // auto iOffset = input->getOffset(
-                                //          {nn, cc + gidx * cpg, posH, posW}),
-                                //      wOffset =
-                                //          weight->getOffset({ff, cc, rr, ss});
-                                auto inputVal = iptr[iOffset],
-                                     weightVal = wptr[wOffset];
-                                val += weightVal * inputVal;
-                            }
-                    // output->setData({nn, ff, hh, ww}, val);
-                    // auto oOffset = output->getOffset({nn, ff, hh, ww});
-                    auto oOffset = ww + w * (hh + h * (ff + f * nn));
-                    optr[oOffset] = val;
-                }
+        auto img = iptr + (size_t)nn * c * h * w;
+        for (int gidx = 0; gidx < g; gidx++) {
+            for (int p0 = 0; p0 < pixels; p0 += tile) {
+                int np = std::min(tile, pixels - p0);
+                cpu::im2col(img, h, w, gidx * cpg, cpg, r, s, ph, pw, sh, sw,
+                            dh, dw, ow, p0, np, col.data());
+                cpu::gemm(fpg, np, K, wptr + (size_t)gidx * fpg * K, K, 1,
+                          col.data(), np,
+                          optr + ((size_t)nn * f + gidx * fpg) * pixels + p0,
+                          pixels);
+            }
         }
     }
     output->setComputed();
@@ -179,12 +160,24 @@ ConvOp::compute(DimRange dr) {
     } else {
         if (dr.getBegin().size() != 4 /*|| dr.getEnd().size() != 4*/)
             return {};
+        // the receptive field of the point in its group, without padding
+        auto &pos = dr.getBegin();
+        int gidx = pos[1] / (f / g);
+        auto inputDr =
+            clipRange({pos[0], gidx * cpg, pos[2] * sh - ph, pos[3] * sw - pw},
+                      {pos[0], gidx * cpg + cpg - 1,
+                       pos[2] * sh + (r - 1) * dh - ph,
+                       pos[3] * sw + (s - 1) * dw - pw},
+                      input->getDims());
+        auto weightDr =
+            DimRange({pos[1], 0, 0, 0}, {pos[1], cpg - 1, r - 1, s - 1});
         return {
-            {DimRange::getAllPos(), DimRange::getAllPos()},
+            {inputDr, weightDr},
             [this, f, g, cpg, r, s, dr]() {
                 auto &pos = dr.getBegin();
                 auto nn = pos[0], ff = pos[1], hh = pos[2], ww = pos[3];
                 auto input = inputs[0], weight = inputs[1], output = outputs[0];
+                auto h = input->getDims()[2], w = input->getDims()[3];
                 int gidx = ff / (f / g);
                 VType val = 0;
                 for (int cc = 0; cc < cpg; cc++)
@@ -192,6 +185,8 @@ ConvOp::compute(DimRange dr) {
                         for (int ss = 0; ss < s; ss++) {
                             int posH = hh * sh + rr * dh - ph;
                             int posW = ww * sw + ss * dw - pw;
+                            if (posH < 0 || posH >= h || posW < 0 || posW >= w)
+                                continue;
                             VType weightVal = weight->getData({ff, cc, rr, ss});
                             VType inputVal = input->getData(
                                 {nn, cc + gidx * cpg, posH, posW});
@@ -506,13 +501,17 @@ std::string ConvOp::toString() const {
 }
 
 void ConvOp::inferSplittingPoints() {
+    if (!checkSplittingPoints())
+        return;
     auto inputSplittingPoints = getInputs()[0]->getSplittingPoints();
     // : Operator(Conv, {input, weight}, {output}), ph(ph), pw(pw), sh(sh),
     // sw(sw),
     //   dh(dh), dw(dw), bias(bias), act(act) {
     assert(inputSplittingPoints->size() == 4);
+    // the boxes of a conv over split input are not inferred
     for (auto &points : *inputSplittingPoints)
-        assert(points.empty());
+        if (!points.empty())
+            return clearSplittingPoints();
 
     SplittingPoints splittingPoints(4);
     int h = inputs[0]->getDims()[2], w = inputs[0]->getDims()[3];
@@ -575,25 +574,31 @@ Tensor *MatmulOp::compute() {
     auto k = transA ? A->getDims()[1] : A->getDims()[2];
     C->dataMalloc();
     auto Aptr = A->getDataPtr(), Bptr = B->getDataPtr(), Cptr = C->getDataPtr();
-#pragma omp parallel for collapse(2)
-    for (int bb = 0; bb < b; ++bb) {
-        for (int mm = 0; mm < m; ++mm) {
-            for (int nn = 0; nn < n; ++nn) {
-                VType tmp = 0;
-                for (int kk = 0; kk < k; ++kk) {
-                    // auto lhs = transA ? A->getData({bb, kk, mm})
-                    //                   : A->getData({bb, mm, kk});
-                    auto lhs = transA ? Aptr[mm + m * (kk + k * bb)]
-                                      : Aptr[kk + k * (mm + m * bb)];
-                    // auto rhs = transB ? B->getData({bb, nn, kk})
-                    //                   : B->getData({bb, kk, nn});
-                    auto rhs = transB ? Bptr[kk + k * (nn + n * bb)]
-                                      : Bptr[nn + n * (kk + k * bb)];
-                    tmp += lhs * rhs;
-                }
-                // C->setData({bb, mm, nn}, tmp);
-                Cptr[nn + n * (mm + m * bb)] = tmp;
-            }
+    // a transposed A is read in place, a transposed B is packed so that its
+    // rows are contiguous
+    size_t rsA = transA ? 1 : k, csA = transA ? m : 1;
+    auto batch = [&](int bb, bool parallel, std::vector<VType> &packed) {
+        auto Bb = Bptr + (size_t)bb * k * n;
+        if (transB) {
+            packed.resize((size_t)k * n);
+            for (int nn = 0; nn < n; ++nn)
+                for (int kk = 0; kk < k; ++kk)
+                    packed[kk * n + nn] = Bb[kk + k * nn];
+            Bb = packed.data();
+        }
+        cpu::gemm(m, n, k, Aptr + (size_t)bb * m * k, rsA, csA, Bb, n,
+                  Cptr + (size_t)bb * m * n, n, parallel);
+    };
+    if (b == 1) {
+        std::vector<VType> packed;
+        batch(0, true, packed);
+    } else {
+#pragma omp parallel
+        {
+            std::vector<VType> packed;
+#pragma omp for schedule(dynamic)
+            for (int bb = 0; bb < b; ++bb)
+                batch(bb, false, packed);
         }
     }
     C->setComputed();
@@ -775,10 +780,13 @@ double MatmulOp::perf(PerfEngine *pe, int rounds, int warmupRounds) {
     return best.time;
 }
 void MatmulOp::inferSplittingPoints() {
+    if (!checkSplittingPoints())
+        return;
     // Assume no prior splitting points
     for (auto tensor : inputs) {
         for (auto v : *tensor->getSplittingPoints())
-            assert(v.size() == 0);
+            if (v.size() != 0)
+                return clearSplittingPoints();
     }
     outputs[0]->initSplittingPoints();
 }
@@ -824,6 +832,7 @@ Tensor *PadOp::compute() {
     if (outputs[0]->isComputed())
         return outputs[0];
 
+    outputs[0]->dataMalloc();
     size_t iEnd = outputs[0]->size();
     const Dim &inDim = inputs[0]->getDims();
     const Dim &outDim = outputs[0]->getDims();
@@ -850,8 +859,29 @@ PadOp::compute(DimRange dr) {
         return {};
     if (dr.isEmpty())
         return {{DimRange::getEmpty()}, []() { return true; }};
-    // TODO: dr should not fall into zero areas
-    return {{DimRange::getAllPos()}, [this]() { return compute() != nullptr; }};
+    if (!dr.isBox())
+        return {{DimRange::getAllPos()},
+                [this]() { return compute() != nullptr; }};
+    if (dr.getBegin().size() != begin.size())
+        return {};
+    // positions in the padded area need no input
+    auto inputDr = clipRange(elementwiseSub(dr.getBegin(), begin),
+                             elementwiseSub(dr.getEnd(), begin),
+                             inputs[0]->getDims(), dr.getStep());
+    return {{inputDr}, [this, dr, inputDr]() {
+                auto input = inputs[0], output = outputs[0];
+                output->dataMalloc();
+                auto pos = dr.getBegin();
+                do {
+                    auto inputPos = elementwiseSub(pos, begin);
+                    // getData is 0 out of the input
+                    VType val =
+                        inputDr.isEmpty() ? 0 : input->getData(inputPos);
+                    if (!output->setData(pos, val))
+                        return false;
+                } while (dr.next(pos));
+                return true;
+            }};
 }
 
 Dim PadOp::computeShape() {
@@ -925,6 +955,12 @@ Tensor *SliceOp::compute() {
     if (outputs[0]->isComputed())
         return outputs[0];
 
+    // the output reads the input through its strides
+    if (outputs[0]->setView(inputs[0], begin)) {
+        outputs[0]->setComputed();
+        return outputs[0];
+    }
+    outputs[0]->dataMalloc();
     size_t iEnd = outputs[0]->size();
     const Dim &outDim = outputs[0]->getDims();
 #pragma omp parallel for
@@ -944,7 +980,24 @@ SliceOp::compute(DimRange dr) {
         return {};
     if (dr.isEmpty())
         return {{DimRange::getEmpty()}, []() { return true; }};
-    return {{DimRange::getAllPos()}, [this]() { return compute() != nullptr; }};
+    if (!dr.isBox())
+        return {{DimRange::getAllPos()},
+                [this]() { return compute() != nullptr; }};
+    if (dr.getBegin().size() != begin.size())
+        return {};
+    auto inputDr = DimRange(elementwiseAdd(dr.getBegin(), begin),
+                            elementwiseAdd(dr.getEnd(), begin), dr.getStep());
+    return {{inputDr}, [this, dr]() {
+                auto input = inputs[0], output = outputs[0];
+                output->dataMalloc();
+                auto pos = dr.getBegin();
+                do {
+                    if (!output->setData(
+                            pos, input->getData(elementwiseAdd(pos, begin))))
+                        return false;
+                } while (dr.next(pos));
+                return true;
+            }};
 }
 
 Dim SliceOp::computeShape() {
@@ -1039,26 +1092,38 @@ ConcatOp::compute(DimRange dr) {
     if (dr.isEmpty())
         return {std::vector<DimRange>(inputs.size(), DimRange::getEmpty()),
                 []() { return true; }};
-    if (!dr.isSinglePos())
+    if (!dr.isBox())
         return {std::vector<DimRange>(inputs.size(), DimRange::getAllPos()),
                 [this]() { return compute() != nullptr; }};
-    auto pos = dr.getBegin();
+    if (dr.getBegin().size() != outputs[0]->getDims().size())
+        return {};
+    // each input gets the part of the box in its slab along dim
+    std::vector<int> offsets;
+    std::vector<DimRange> ret;
     int dimSum = 0;
-    size_t idx = 0;
-    for (auto numInputs = inputs.size(); idx < numInputs; ++idx) {
-        dimSum += inputs[idx]->getDims()[dim];
-        if (pos[dim] < dimSum) {
-            dimSum -= inputs[idx]->getDims()[dim];
-            break;
-        }
-    }
-    auto inputPos = pos;
-    inputPos[dim] = inputPos[dim] - dimSum;
-    auto ret = std::vector<DimRange>(inputs.size(), DimRange::getEmpty());
-    ret[idx] = inputPos;
-    return {ret, [this, pos, idx, inputPos]() {
-                outputs[0]->dataMalloc();
-                return outputs[0]->setData(pos, inputs[idx]->getData(inputPos));
+    for (auto input : inputs) {
+        auto begin = dr.getBegin(), end = dr.getEnd();
+        begin[dim] -= dimSum;
+        end[dim] -= dimSum;
+        offsets.emplace_back(dimSum);
+        ret.emplace_back(
+            clipRange(begin, end, input->getDims(), dr.getStep()));
+        dimSum += input->getDims()[dim];
+    }
+    return {ret, [this, dr, offsets]() {
+                auto output = outputs[0];
+                output->dataMalloc();
+                auto pos = dr.getBegin();
+                do {
+                    size_t idx = std::upper_bound(offsets.begin(),
+                                                  offsets.end(), pos[dim]) -
+                                 offsets.begin() - 1;
+                    auto inputPos = pos;
+                    inputPos[dim] -= offsets[idx];
+                    if (!output->setData(pos, inputs[idx]->getData(inputPos)))
+                        return false;
+                } while (dr.next(pos));
+                return true;
             }};
 }
 
@@ -1086,6 +1151,8 @@ bool ConcatOp::checkValid(const TensorVec &tensors) {
 }
 
 void ConcatOp::inferSplittingPoints() {
+    if (!checkSplittingPoints())
+        return;
     // Wihtout enough test
     SplittingPoints points(inputs[0]->getDims().size());
     for (int i = 0; i < (int)inputs[0]->getDims().size(); ++i) {
@@ -1143,6 +1210,11 @@ SplitOp::SplitOp(int dim, const std::vector<int> &sizes)
     initHash();
 }
 
+SplitOp::SplitOp(int dim, int num, const std::vector<int> &sizes)
+    : Operator(Split), dim(dim), num(num), sizes(sizes) {
+    initHash();
+}
+
 void SplitOp::initHash() {
     hash = type;
     hash = hashAppend(hash, dim);
@@ -1167,6 +1239,18 @@ TensorVec SplitOp::computeV() {
 
     auto input = inputs[0];
     auto &iDim = input->getDims();
+    // each output is a view of its part of the input
+    Dim viewBegin(iDim.size(), 0);
+    auto allViews = true;
+    for (auto output : outputs) {
+        allViews &= output->setView(input, viewBegin);
+        viewBegin[dim] += output->getDims()[dim];
+    }
+    if (allViews) {
+        for (auto output : outputs)
+            output->setComputed();
+        return outputs;
+    }
     std::vector<Dim> oDims;
     for (auto output : outputs)
         oDims.emplace_back(output->getDims());
@@ -1213,17 +1297,29 @@ SplitOp::compute(size_t idx, DimRange dr) {
         return {};
     if (dr.isEmpty())
         return {{DimRange::getEmpty()}, []() { return true; }};
-    if (!dr.isSinglePos())
+    if (!dr.isBox())
         return {{DimRange::getAllPos()},
                 [this]() { return !computeV().empty(); }};
-    auto pos = dr.getBegin();
-    auto inputPos = pos;
-    for (size_t i = 0; i < idx; ++i) {
-        inputPos[dim] += outputs[i]->getDims()[dim];
-    }
-    return {{DimRange(inputPos)}, [this, pos, idx, inputPos]() {
-                outputs[idx]->dataMalloc();
-                return outputs[idx]->setData(pos, inputs[0]->getData(inputPos));
+    if (dr.getBegin().size() != inputs[0]->getDims().size())
+        return {};
+    int offset = 0;
+    for (size_t i = 0; i < idx; ++i)
+        offset += outputs[i]->getDims()[dim];
+    auto begin = dr.getBegin(), end = dr.getEnd();
+    begin[dim] += offset;
+    end[dim] += offset;
+    return {{DimRange(begin, end, dr.getStep())},
+            [this, dr, idx, offset]() {
+                auto output = outputs[idx];
+                output->dataMalloc();
+                auto pos = dr.getBegin();
+                do {
+                    auto inputPos = pos;
+                    inputPos[dim] += offset;
+                    if (!output->setData(pos, inputs[0]->getData(inputPos)))
+                        return false;
+                } while (dr.next(pos));
+                return true;
             }};
 }
 
@@ -1356,6 +1452,19 @@ Tensor *TransposeOp::compute() {
     if (outputs[0]->isComputed())
         return outputs[0];
 
+    // a pure permutation only reorders the strides of the input
+    std::vector<int> perm;
+    for (size_t i = 0, iEnd = after.size(); i < iEnd; ++i)
+        if (after[i].isSingle())
+            perm.emplace_back(after[i].getVec()[0]);
+    bool permOnly = perm.size() == after.size();
+    for (size_t i = 0, iEnd = before.size(); i < iEnd; ++i)
+        permOnly = permOnly && before[i].isSingle();
+    if (permOnly && outputs[0]->setTransposeView(inputs[0], perm)) {
+        outputs[0]->setComputed();
+        return outputs[0];
+    }
+
     outputs[0]->dataMalloc();
     Dim flatDim;
     for (size_t i = 0, iEnd = before.size(); i < iEnd; ++i) {
@@ -1376,86 +1485,55 @@ Tensor *TransposeOp::compute() {
         }
     }
 
-    size_t iEnd = inputs[0]->size();
-#pragma omp parallel for
-    for (size_t i = 0; i < iEnd; ++i) {
-        Dim flatIt = cntToIdx(flatDim, i);
-        int afterIdx = 0;
-        for (int j = 0, jEnd = after.size(); j < jEnd; ++j) {
-            auto &pos = after[j].getVec();
-            for (size_t k = 0, kEnd = pos.size(); k < kEnd; ++k)
-                afterIdx = afterIdx * flatDim[pos[k]] + flatIt[pos[k]];
+    // strides of the flat dims in the input and in the output
+    Dim iStrides, oStrides(flatDim.size(), 0);
+    auto strides = inputs[0]->getStrides();
+    for (size_t i = 0, iEnd = before.size(); i < iEnd; ++i) {
+        if (!before[i].isSingle())
+            iStrides.emplace_back(strides[i] * flatDim[iStrides.size() + 1]);
+        iStrides.emplace_back(strides[i]);
+    }
+    int oStride = 1;
+    for (int j = after.size() - 1; j >= 0; --j) {
+        auto &pos = after[j].getVec();
+        for (int k = pos.size() - 1; k >= 0; --k) {
+            oStrides[pos[k]] = oStride;
+            oStride *= flatDim[pos[k]];
         }
-        outputs[0]->setData(afterIdx, inputs[0]->getData(i));
     }
+    auto i_ptr = inputs[0]->getReadPtr(), o_ptr = outputs[0]->getDataPtr();
+    StridedLoop loop(flatDim, {iStrides, oStrides});
+    auto is = loop.getInnerStride(0), os = loop.getInnerStride(1);
+    loop.parallelFor([&](const size_t *offsets, size_t n) {
+        auto from = i_ptr + offsets[0], to = o_ptr + offsets[1];
+        for (size_t j = 0; j < n; ++j)
+            to[j * os] = from[j * is];
+    });
     outputs[0]->setComputed();
     return outputs[0];
 }
 
-std::pair<std::vector<DimRange>, std::function<bool()>>
-TransposeOp::compute(DimRange dr) {
-    if (dr.notValid())
-        return {};
-    if (dr.isEmpty())
-        return {{DimRange::getEmpty()}, []() { return true; }};
-    if (!dr.isSinglePos()) {
-        return {{DimRange::getAllPos()},
-                [this]() { return compute() != nullptr; }};
-    }
-    auto pos = dr.getBegin();
-    auto input = inputs[0], output = outputs[0];
-    if (pos.size() != input->getDims().size())
-        return {};
-    for (size_t i = 0, iEnd = pos.size(); i < iEnd; ++i)
-        if (pos[i] >= output->getDims()[i])
-            return {};
-
-    Dim reshapeDim1;
-    for (size_t i = 0, iEnd = before.size(); i < iEnd; ++i) {
-        if (before[i].isSingle())
-            reshapeDim1.emplace_back(inputs[0]->getDims()[i]);
-        else {
-            assert(before[i].getVec().size() == 2);
-            if (factor > 0) {
-                reshapeDim1.emplace_back(inputs[0]->getDims()[i] / factor);
-                if (inputs[0]->getDims()[i] % factor != 0)
-                    return {};
-                reshapeDim1.emplace_back(factor);
-            } else {
-                reshapeDim1.emplace_back(-factor);
-                reshapeDim1.emplace_back(inputs[0]->getDims()[i] / (-factor));
-                if (inputs[0]->getDims()[i] % (-factor) != 0)
-                    return {};
-            }
-        }
-    }
-
-    // Dim reshapeDim2 = Dim(reshapeDim1.size(), 0);
-    // auto beforeVec = before.asVector(), afterVec = after.asVector();
-    // assert(beforeVec.size() == afterVec.size());
-    // for (size_t i = 0, iEnd = beforeVec.size(); i < iEnd; ++i)
-    //     reshapeDim2[i] = reshapeDim1[afterVec[i]];
-
+Dim TransposeOp::getInputPos(const Dim &flatDims, const Dim &pos) const {
     Dim afterFlatIt;
     for (size_t i = 0, iEnd = after.size(); i < iEnd; ++i) {
         if (after[i].isSingle())
             afterFlatIt.emplace_back(pos[i]);
         else {
-            auto localPerm = after[i].getVec();
+            auto &localPerm = after[i].getVec();
             auto localSz = localPerm.size();
             Dim localFlatIt = Dim(localSz, 0);
             auto idx = localSz - 1;
             auto cur = pos[i];
             while (cur > 0) {
-                localFlatIt[idx] = cur % reshapeDim1[localPerm[idx]];
-                cur /= reshapeDim1[localPerm[idx]];
+                localFlatIt[idx] = cur % flatDims[localPerm[idx]];
+                cur /= flatDims[localPerm[idx]];
                 idx--;
             }
             for (auto dm : localFlatIt)
                 afterFlatIt.emplace_back(dm);
         }
     }
-    assert(afterFlatIt.size() == reshapeDim1.size());
+    assert(afterFlatIt.size() == flatDims.size());
 
     auto afterVec = after.asVector();
     Dim beforeFlatIt = Dim(afterFlatIt.size(), 0);
@@ -1467,21 +1545,74 @@ TransposeOp::compute(DimRange dr) {
         if (before[i].isSingle())
             inputPos.emplace_back(beforeFlatIt[j++]);
         else {
-            auto localPerm = before[i].getVec();
+            auto &localPerm = before[i].getVec();
             size_t localIdx = 0;
             auto localPos = beforeFlatIt[j + localIdx];
             while (++localIdx < localPerm.size()) {
-                localPos = localPos * reshapeDim1[j + localIdx] +
+                localPos = localPos * flatDims[j + localIdx] +
                            beforeFlatIt[j + localIdx];
             }
             j += localPerm.size();
             inputPos.emplace_back(localPos);
         }
     }
+    return inputPos;
+}
 
-    return {{DimRange(inputPos)}, [this, pos, inputPos]() {
-                outputs[0]->dataMalloc();
-                return outputs[0]->setData(pos, inputs[0]->getData(inputPos));
+std::pair<std::vector<DimRange>, std::function<bool()>>
+TransposeOp::compute(DimRange dr) {
+    if (dr.notValid())
+        return {};
+    if (dr.isEmpty())
+        return {{DimRange::getEmpty()}, []() { return true; }};
+    if (!dr.isBox()) {
+        return {{DimRange::getAllPos()},
+                [this]() { return compute() != nullptr; }};
+    }
+    auto input = inputs[0], output = outputs[0];
+    if (dr.getBegin().size() != input->getDims().size())
+        return {};
+    for (size_t i = 0, iEnd = dr.getEnd().size(); i < iEnd; ++i)
+        if (dr.getEnd()[i] >= output->getDims()[i])
+            return {};
+
+    Dim reshapeDim1;
+    for (size_t i = 0, iEnd = before.size(); i < iEnd; ++i) {
+        if (before[i].isSingle())
+            reshapeDim1.emplace_back(inputs[0]->getDims()[i]);
+        else {
+            assert(before[i].getVec().size() == 2);
+            if (factor > 0) {
+                reshapeDim1.emplace_back(inputs[0]->getDims()[i] / factor);
+                if (inputs[0]->getDims()[i] % factor != 0)
+                    return {};
+                reshapeDim1.emplace_back(factor);
+            } else {
+                reshapeDim1.emplace_back(-factor);
+                reshapeDim1.emplace_back(inputs[0]->getDims()[i] / (-factor));
+                if (inputs[0]->getDims()[i] % (-factor) != 0)
+                    return {};
+            }
+        }
+    }
+
+    // a box maps to a box without split or merge, and to strided boxes or a
+    // few boxes otherwise
+    DimRange inputDr = DimRange::getEmpty();
+    auto pos = dr.getBegin();
+    do {
+        inputDr = unionRange(inputDr, getInputPos(reshapeDim1, pos));
+    } while (dr.next(pos));
+    return {{inputDr}, [this, dr, reshapeDim1]() {
+                auto output = outputs[0];
+                output->dataMalloc();
+                auto pos = dr.getBegin();
+                do {
+                    auto inputPos = getInputPos(reshapeDim1, pos);
+                    if (!output->setData(pos, inputs[0]->getData(inputPos)))
+                        return false;
+                } while (dr.next(pos));
+                return true;
             }};
 }
 
@@ -1520,34 +1651,28 @@ bool TransposeOp::checkValid(const TensorVec &inputs) {
     return true;
 }
 
-Dim TransposeOp::computeShape() {
+Dim TransposeOp::inferShape(const Dim &inputDims) const {
     Dim flatDim;
     for (size_t i = 0, iEnd = before.size(); i < iEnd; ++i) {
         if (before[i].isSingle())
-            flatDim.emplace_back(inputs[0]->getDims()[i]);
+            flatDim.emplace_back(inputDims[i]);
         else {
             if (factor > 0) {
                 // TODO: unequal split?
-                if (inputs[0]->getDims()[i] % factor != 0 ||
-                    inputs[0]->getDims()[i] < factor) {
-                    outputs[0]->setInvalid();
+                if (inputDims[i] % factor != 0 || inputDims[i] < factor)
                     return {};
-                }
-                flatDim.emplace_back(inputs[0]->getDims()[i] / factor);
+                flatDim.emplace_back(inputDims[i] / factor);
                 flatDim.emplace_back(factor);
             } else {
                 // TODO: unequal split?
-                if (inputs[0]->getDims()[i] % (-factor) != 0 ||
-                    inputs[0]->getDims()[i] < (-factor)) {
-                    outputs[0]->setInvalid();
+                if (inputDims[i] % (-factor) != 0 || inputDims[i] < (-factor))
                     return {};
-                }
                 flatDim.emplace_back(-factor);
-                flatDim.emplace_back(inputs[0]->getDims()[i] / (-factor));
+                flatDim.emplace_back(inputDims[i] / (-factor));
             }
         }
     }
-    Dim ret = Dim(after.getPerm().size(), 0);
+    Dim ret = Dim(after.size(), 0);
     for (size_t i = 0; i < after.size(); ++i) {
         if (after[i].isSingle())
             ret[i] = flatDim[after[i].getSingle()];
@@ -1558,6 +1683,15 @@ Dim TransposeOp::computeShape() {
                 ret[i] *= flatDim[pitem[j]];
         }
     }
+    return ret;
+}
+
+Dim TransposeOp::computeShape() {
+    Dim ret = inferShape(inputs[0]->getDims());
+    if (ret.empty()) {
+        outputs[0]->setInvalid();
+        return {};
+    }
     outputs[0]->setDims(ret);
     outputs[0]->setType(inputs[0]->getType());
     return ret;
@@ -1645,80 +1779,80 @@ std::vector<std::shared_ptr<TransBasic>> TransposeOp::getTTParam() const {
 
 void TransposeOp::inferSplittingPoints() {
     assert(inputs.size() == 1);
+    if (!checkSplittingPoints())
+        return;
     auto const input = inputs[0];
     const auto &inputSplittingPoints = *input->getSplittingPoints();
-    assert(before.size() == after.size());
-    SplittingPoints intermediatePoints(after.size() + 1);
-    SplittingPoints ret(after.size());
-
-    assert(factor == 2 || factor == -2);
+    assert(before.size() == input->getDims().size());
 
-    // Splitting an axis
+    // Splitting an axis of size n into (outer, inner). A point p becomes
+    // p % inner on the inner axis, and the rows of the outer axis around p
+    // are kept apart unless p falls on a row boundary.
+    int flatSz = 0;
+    for (size_t i = 0, iEnd = before.size(); i < iEnd; ++i)
+        flatSz += before[i].isSingle() ? 1 : 2;
+    SplittingPoints flatPoints(flatSz);
+    Dim flatDims(flatSz);
     for (size_t i = 0, iEnd = before.size(); i < iEnd; ++i) {
-        if (before[i].isSingle())
-            intermediatePoints[before[i].getSingle()] = inputSplittingPoints[i];
-        else {
-            int k = (factor > 0) ? factor : -factor;
-            if (factor > 0) {
-                // check unequal split
-                assert(inputs[0]->getDims()[i] % k == 0);
-                for (int pos : inputSplittingPoints[i])
-                    intermediatePoints[before[i].getVec()[0]].emplace_back(pos %
-                                                                           k);
-            } else {
-                assert(inputs[0]->getDims()[i] % (-factor) == 0);
-                for (int pos : inputSplittingPoints[i]) {
-                    intermediatePoints[before[i].getVec()[1]].emplace_back(pos /
-                                                                           k);
-                    // splitting points surrounding the original points
-                    // to avoid merged boxes. It is sometimes redundent.
-                    if (pos % k != 0 &&
-                        pos / k + 1 < inputs[0]->getDims()[i] / k)
-                        intermediatePoints[before[i].getVec()[1]].emplace_back(
-                            pos / k + 1);
-                }
+        int n = input->getDims()[i];
+        if (before[i].isSingle()) {
+            flatPoints[before[i].getSingle()] = inputSplittingPoints[i];
+            flatDims[before[i].getSingle()] = n;
+            continue;
+        }
+        int inner = factor > 0 ? factor : n / (-factor);
+        assert(inner > 0 && n % inner == 0);
+        std::vector<int> outerPoints, innerPoints;
+        for (int pos : inputSplittingPoints[i]) {
+            if (pos / inner > 0)
+                outerPoints.emplace_back(pos / inner);
+            if (pos % inner != 0) {
+                innerPoints.emplace_back(pos % inner);
+                if (pos / inner + 1 < n / inner)
+                    outerPoints.emplace_back(pos / inner + 1);
             }
         }
+        auto &axes = before[i].getVec();
+        flatPoints[axes[0]] = std::move(outerPoints);
+        flatPoints[axes[1]] = std::move(innerPoints);
+        flatDims[axes[0]] = n / inner;
+        flatDims[axes[1]] = inner;
     }
+    for (auto &points : flatPoints)
+        sort(points.begin(), points.end());
 
-    // find the original dim from the before/after index
-    auto find_before_index = [this](int k) -> int {
-        for (int i = 0; i < (int)this->before.size(); ++i) {
-            if (this->before[i].isSingle()) {
-                if (this->before[i].getSingle() == k)
-                    return i;
-            } else if (this->before[i].getVec()[0] == k ||
-                       this->before[i].getVec()[1] == k)
-                return i;
-        }
-        assert(0);
-        return -1;
+    // Merging axes. A position of the merged axis is a point if any of its
+    // digits moves to another box of its axis from the previous position,
+    // which also covers the wrap around of the inner digits.
+    auto boxOf = [&](int axis, int v) {
+        auto &points = flatPoints[axis];
+        return upper_bound(points.begin(), points.end(), v) - points.begin();
     };
-
-    // Merge two axes
-    // the new axis of (0..factor)
-    int splitKDim = before[split].getVec()[(factor > 0) ? 1 : 0];
+    SplittingPoints ret(after.size());
     for (size_t i = 0; i < after.size(); ++i) {
-        if (after[i].isSingle())
-            ret[i] = intermediatePoints[after[i].getSingle()];
-        else {
-            if (after[i].getVec()[0] == splitKDim) { // (K, W)
-                if (intermediatePoints[after[i].getVec()[1]].empty())
-                    continue;
-                ret[i] = intermediatePoints[after[i].getVec()[1]];
-                int origin_size =
-                    input->getDims()[find_before_index(after[i].getVec()[1])];
-                ret[i].emplace_back(origin_size);
-                for (int pos : intermediatePoints[after[i].getVec()[1]])
-                    ret[i].emplace_back(origin_size + pos);
-            } else if (after[i].getVec()[1] == splitKDim) { // (W, K)
-                // interleaving merging
-                for (int pos : intermediatePoints[after[i].getVec()[0]]) {
-                    ret[i].emplace_back(pos * 2);
-                    ret[i].emplace_back(pos * 2 + 1);
+        if (after[i].isSingle()) {
+            ret[i] = flatPoints[after[i].getSingle()];
+            continue;
+        }
+        auto &axes = after[i].getVec();
+        bool noPoints = true;
+        int size = 1;
+        for (int axis : axes) {
+            noPoints &= flatPoints[axis].empty();
+            size *= flatDims[axis];
+        }
+        if (noPoints)
+            continue;
+        for (int pos = 1; pos < size; ++pos) {
+            int cur = pos, prev = pos - 1;
+            for (int j = (int)axes.size() - 1; j >= 0; --j) {
+                int len = flatDims[axes[j]];
+                if (boxOf(axes[j], cur % len) != boxOf(axes[j], prev % len)) {
+                    ret[i].emplace_back(pos);
+                    break;
                 }
-            } else
-                assert(0);
+                cur /= len, prev /= len;
+            }
         }
     }
     // remove duplicates
@@ -1790,16 +1924,34 @@ ExtendOp::compute(DimRange dr) {
         return {};
     if (dr.isEmpty())
         return {{DimRange::getEmpty()}, []() { return true; }};
-    if (!dr.isSinglePos())
+    if (!dr.isBox())
         return {{DimRange::getAllPos()},
                 [this]() { return compute() != nullptr; }};
     auto iDim = inputs[0]->getDims();
-    auto pos = dr.getBegin();
-    auto inputPos = pos;
-    inputPos[dim] %= iDim[dim];
-    return {{DimRange(inputPos)}, [this, pos, inputPos]() {
-                outputs[0]->dataMalloc();
-                return outputs[0]->setData(pos, inputs[0]->getData(inputPos));
+    if (dr.getBegin().size() != iDim.size())
+        return {};
+    // the copies along dim wrap around the input
+    auto begin = dr.getBegin(), end = dr.getEnd(), step = dr.getStep();
+    begin[dim] %= iDim[dim];
+    end[dim] %= iDim[dim];
+    if (dr.getEnd()[dim] - dr.getBegin()[dim] >= iDim[dim] ||
+        begin[dim] > end[dim]) {
+        begin[dim] = 0;
+        end[dim] = iDim[dim] - 1;
+        if (!step.empty())
+            step[dim] = 1;
+    }
+    return {{DimRange(begin, end, step)}, [this, dr, iDim]() {
+                auto output = outputs[0];
+                output->dataMalloc();
+                auto pos = dr.getBegin();
+                do {
+                    auto inputPos = pos;
+                    inputPos[dim] %= iDim[dim];
+                    if (!output->setData(pos, inputs[0]->getData(inputPos)))
+                        return false;
+                } while (dr.next(pos));
+                return true;
             }};
 }
 
@@ -1851,18 +2003,29 @@ Tensor *BatchNormOp::compute() {
     auto input = inputs[0];
     auto output = outputs[0];
     output->dataMalloc();
-    input->itReset();
-    auto c = input->getDims()[1];
+    auto &dims = input->getDims();
+    auto c = dims[1];
     auto vec = std::vector<double>(c, 0);
-    for (int cc = 0; cc < c; ++cc)
+    auto m = std::vector<VType>(c, 0), b = std::vector<VType>(c, 0);
+    for (int cc = 0; cc < c; ++cc) {
         vec[cc] = scale->getData(cc) / sqrt(var->getData(cc) + epsilon);
-    while (input->itValid()) {
-        auto iit = input->itGet();
-        auto cc = iit[1];
-        VType val = (input->getData(iit) - mean->getData(cc)) * vec[cc] +
-                    bias->getData(cc);
-        output->setData(iit, val);
-    }
+        m[cc] = mean->getData(cc);
+        b[cc] = bias->getData(cc);
+    }
+    // the third operand walks the channels, a run crosses channels when the
+    // dims after them are all 1
+    Dim channel(dims.size(), 0);
+    channel[1] = 1;
+    auto i_ptr = input->getReadPtr(), o_ptr = output->getDataPtr();
+    StridedLoop loop(dims, {input->getStrides(), denseStrides(dims), channel});
+    auto is = loop.getInnerStride(0), cs = loop.getInnerStride(2);
+    loop.parallelFor([&](const size_t *offsets, size_t n) {
+        auto from = i_ptr + offsets[0], to = o_ptr + offsets[1];
+        for (size_t j = 0; j < n; ++j) {
+            auto cc = offsets[2] + j * cs;
+            to[j] = (from[j * is] - m[cc]) * vec[cc] + b[cc];
+        }
+    });
     output->setComputed();
     return output;
 }
@@ -1873,7 +2036,9 @@ BatchNormOp::compute(DimRange dr) {
         return {};
     if (dr.isEmpty())
         return {{DimRange::getEmpty()}, []() { return true; }};
-    return {{dr}, [this]() { return compute() != nullptr; }};
+    // compute() reads the whole input
+    return {{DimRange::getAllPos()},
+            [this]() { return compute() != nullptr; }};
 }
 
 bool BatchNormOp::checkValid(const TensorVec &inputs) {
@@ -2176,13 +2341,17 @@ Tensor *AddOp::compute() {
     auto o_ptr = output->getDataPtr();
     for (size_t i = 0, iEnd = output->size(); i < iEnd; ++i)
         o_ptr[i] = 0;
-    auto oSz = output->size();
+    auto &oDims = output->getDims();
+    auto oStrides = denseStrides(oDims);
     for (auto input : inputs) {
-        auto iSz = input->size();
-        auto i_ptr = input->getDataPtr();
-#pragma omp parallel for
-        for (size_t i = 0; i < oSz; ++i)
-            o_ptr[i] += i_ptr[i % iSz];
+        auto i_ptr = input->getReadPtr();
+        StridedLoop loop(oDims, {oStrides, input->getBroadcastStrides(oDims)});
+        auto is = loop.getInnerStride(1);
+        loop.parallelFor([&](const size_t *offsets, size_t n) {
+            auto to = o_ptr + offsets[0], from = i_ptr + offsets[1];
+            for (size_t j = 0; j < n; ++j)
+                to[j] += from[j * is];
+        });
     }
     output->setComputed();
     return output;
@@ -2196,7 +2365,7 @@ AddOp::compute(DimRange dr) {
         return {std::vector<DimRange>(inputs.size(), DimRange::getEmpty()),
                 []() { return true; }};
     if (!dr.isSinglePos())
-        return {std::vector<DimRange>(inputs.size(), dr),
+        return {std::vector<DimRange>(inputs.size(), DimRange::getAllPos()),
                 [this]() { return compute() != nullptr; }};
     auto pos = dr.getBegin();
     return {std::vector<DimRange>(inputs.size(), dr), [this, pos]() {
@@ -2282,7 +2451,7 @@ SubOp::compute(DimRange dr) {
         return {std::vector<DimRange>(inputs.size(), DimRange::getEmpty()),
                 []() { return true; }};
     if (!dr.isSinglePos())
-        return {std::vector<DimRange>(inputs.size(), dr),
+        return {std::vector<DimRange>(inputs.size(), DimRange::getAllPos()),
                 [this]() { return compute() != nullptr; }};
     auto pos = dr.getBegin();
     return {std::vector<DimRange>(inputs.size(), dr), [this, pos]() {
@@ -2348,13 +2517,17 @@ Tensor *MulOp::compute() {
     auto o_ptr = output->getDataPtr();
     for (size_t i = 0, iEnd = output->size(); i < iEnd; ++i)
         o_ptr[i] = 1;
-    auto oSz = output->size();
+    auto &oDims = output->getDims();
+    auto oStrides = denseStrides(oDims);
     for (auto input : inputs) {
-        auto iSz = input->size();
-        auto i_ptr = input->getDataPtr();
-#pragma omp parallel for
-        for (size_t i = 0; i < oSz; ++i)
-            o_ptr[i] *= i_ptr[i % iSz];
+        auto i_ptr = input->getReadPtr();
+        StridedLoop loop(oDims, {oStrides, input->getBroadcastStrides(oDims)});
+        auto is = loop.getInnerStride(1);
+        loop.parallelFor([&](const size_t *offsets, size_t n) {
+            auto to = o_ptr + offsets[0], from = i_ptr + offsets[1];
+            for (size_t j = 0; j < n; ++j)
+                to[j] *= from[j * is];
+        });
     }
     output->setComputed();
     return output;
@@ -2368,7 +2541,7 @@ MulOp::compute(DimRange dr) {
         return {std::vector<DimRange>(inputs.size(), DimRange::getEmpty()),
                 []() { return true; }};
     if (!dr.isSinglePos())
-        return {std::vector<DimRange>(inputs.size(), dr),
+        return {std::vector<DimRange>(inputs.size(), DimRange::getAllPos()),
                 [this]() { return compute() != nullptr; }};
     auto pos = dr.getBegin();
     return {std::vector<DimRange>(inputs.size(), dr), [this, pos]() {
@@ -2454,7 +2627,7 @@ DivOp::compute(DimRange dr) {
         return {std::vector<DimRange>(inputs.size(), DimRange::getEmpty()),
                 []() { return true; }};
     if (!dr.isSinglePos())
-        return {std::vector<DimRange>(inputs.size(), dr),
+        return {std::vector<DimRange>(inputs.size(), DimRange::getAllPos()),
                 [this]() { return compute() != nullptr; }};
     auto pos = dr.getBegin();
     return {std::vector<DimRange>(inputs.size(), dr), [this, pos]() {
@@ -2535,7 +2708,7 @@ PowOp::compute(DimRange dr) {
         return {std::vector<DimRange>(inputs.size(), DimRange::getEmpty()),
                 []() { return true; }};
     if (!dr.isSinglePos())
-        return {std::vector<DimRange>(inputs.size(), dr),
+        return {std::vector<DimRange>(inputs.size(), DimRange::getAllPos()),
                 [this]() { return compute() != nullptr; }};
     auto pos = dr.getBegin();
     return {std::vector<DimRange>(inputs.size(), dr), [this, pos]() {
@@ -2689,10 +2862,14 @@ Tensor *IdentityOp::compute() {
     //     return outputs[0];
 
     auto input = inputs[0], output = outputs[0];
+    if (output->setView(input, Dim(input->getDims().size(), 0))) {
+        output->setComputed();
+        return output;
+    }
     output->dataMalloc();
-    auto inputP = input->getDataPtr(), outputP = output->getDataPtr();
+    auto outputP = output->getDataPtr();
     for (size_t i = 0, iEnd = input->size(); i < iEnd; ++i)
-        outputP[i] = inputP[i];
+        outputP[i] = input->getData(i);
     output->setComputed();
     return output;
 }
@@ -2703,7 +2880,18 @@ IdentityOp::compute(DimRange dr) {
         return {};
     if (dr.isEmpty())
         return {{DimRange::getEmpty()}, []() { return true; }};
-    return {{dr}, [this]() { return compute() != nullptr; }};
+    if (!dr.isBox())
+        return {{dr}, [this]() { return compute() != nullptr; }};
+    return {{dr}, [this, dr]() {
+                auto output = outputs[0];
+                output->dataMalloc();
+                auto pos = dr.getBegin();
+                do {
+                    if (!output->setData(pos, inputs[0]->getData(pos)))
+                        return false;
+                } while (dr.next(pos));
+                return true;
+            }};
 }
 
 Dim IdentityOp::computeShape() {
@@ -2717,11 +2905,16 @@ Tensor *ReshapeOp::compute() {
     // if (outputs[0]->isComputed())
     //     return outputs[0];
 
+    // a strided input is copied in the flat order of the output
     auto input = inputs[0], output = outputs[0];
+    if (output->setReshapeView(input)) {
+        output->setComputed();
+        return output;
+    }
     output->dataMalloc();
-    auto inputP = input->getDataPtr(), outputP = output->getDataPtr();
+    auto outputP = output->getDataPtr();
     for (size_t i = 0, iEnd = input->size(); i < iEnd; ++i)
-        outputP[i] = inputP[i];
+        outputP[i] = input->getData(i);
     output->setComputed();
     return output;
 }
@@ -2732,20 +2925,31 @@ ReshapeOp::compute(DimRange dr) {
         return {};
     if (dr.isEmpty())
         return {{DimRange::getEmpty()}, []() { return true; }};
-    if (dr.isSinglePos()) {
-        size_t offset = outputs[0]->getOffset(dr.getBegin());
-        const Dim &input_dims = inputs[0]->getDims();
-        Dim input_pos = input_dims;
-        for (int i = (int)input_dims.size() - 1; i >= 0; --i) {
-            input_pos[i] = offset % input_dims[i];
-            offset /= input_dims[i];
-        }
-        return {{DimRange::getAllPos()},
-                // return {{input_pos},
-                [this]() { return compute() != nullptr; }};
-    } else
+    if (!dr.isBox())
         return {{DimRange::getAllPos()},
                 [this]() { return compute() != nullptr; }};
+    auto input = inputs[0], output = outputs[0];
+    if (dr.getBegin().size() != output->getDims().size())
+        return {};
+    // the input positions with the same offsets
+    DimRange inputDr = DimRange::getEmpty();
+    auto pos = dr.getBegin();
+    do {
+        inputDr = unionRange(
+            inputDr, cntToIdx(input->getDims(), output->getOffset(pos)));
+    } while (dr.next(pos));
+    return {{inputDr}, [this, dr]() {
+                auto output = outputs[0];
+                output->dataMalloc();
+                auto pos = dr.getBegin();
+                do {
+                    auto offset = output->getOffset(pos);
+                    if (offset == (size_t)-1 ||
+                        !output->setData(offset, inputs[0]->getData(offset)))
+                        return false;
+                } while (dr.next(pos));
+                return true;
+            }};
 }
 
 void ReshapeOp::initHash() {
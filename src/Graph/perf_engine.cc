@@ -73,4 +73,104 @@ void PerfEngine::dumpPerfData() {
     printf("\n============ end perf ============\n");
 }
 
+template <class Tuple, size_t... Is>
+static void saveTuple(std::ostream &os, const Tuple &t, aux::seq<Is...>) {
+    using swallow = int[];
+    (void)swallow{0, (void(os << " " << std::get<Is>(t)), 0)...};
+}
+
+template <class Tuple, size_t... Is>
+static bool loadTuple(std::istream &is, Tuple &t, aux::seq<Is...>) {
+    using swallow = int[];
+    (void)swallow{0, (void(is >> std::get<Is>(t)), 0)...};
+    return bool(is);
+}
+
+// one entry per line: <kind> <args...> <result...>
+void PerfEngine::savePerfData(std::ostream &os) const {
+    for (const auto &kv : convPerf) {
+        os << "conv";
+        saveTuple(os, kv.first, aux::gen_seq<16>());
+        os << " " << kv.second.time << " " << kv.second.algo << " "
+           << kv.second.workspaceSize << "\n";
+    }
+    for (const auto &kv : matmulPerf) {
+        os << "matmul";
+        saveTuple(os, kv.first, aux::gen_seq<6>());
+        os << " " << kv.second.time << " " << kv.second.useStrideBatchAPI
+           << " " << kv.second.algo << "\n";
+    }
+    for (const auto &kv : maxPoolPerf) {
+        os << "maxpool";
+        saveTuple(os, kv.first, aux::gen_seq<8>());
+        os << " " << kv.second << "\n";
+    }
+    for (const auto &kv : avgPoolPerf) {
+        os << "avgpool";
+        saveTuple(os, kv.first, aux::gen_seq<8>());
+        os << " " << kv.second << "\n";
+    }
+    os << "end\n";
+}
+
+int PerfEngine::loadPerfData(std::istream &is) {
+    PerfData data;
+    if (parsePerfData(is, data))
+        return 1;
+    mergePerfData(data);
+    return 0;
+}
+
+int PerfEngine::parsePerfData(std::istream &is, PerfData &data) {
+    std::string kind;
+    while (is >> kind) {
+        if (kind == "end")
+            return 0;
+        if (kind == "conv") {
+            ConvArgs args;
+            ConvResult res;
+            int algo;
+            if (!loadTuple(is, args, aux::gen_seq<16>()) ||
+                !(is >> res.time >> algo >> res.workspaceSize))
+                break;
+            res.algo = (cudnnConvolutionFwdAlgo_t)algo;
+            data.convPerf[args] = res;
+        } else if (kind == "matmul") {
+            MatmulArgs args;
+            MatmulResult res;
+            int algo;
+            if (!loadTuple(is, args, aux::gen_seq<6>()) ||
+                !(is >> res.time >> res.useStrideBatchAPI >> algo))
+                break;
+            res.algo = (cublasGemmAlgo_t)algo;
+            data.matmulPerf[args] = res;
+        } else if (kind == "maxpool" || kind == "avgpool") {
+            PoolArgs args;
+            float time;
+            if (!loadTuple(is, args, aux::gen_seq<8>()) || !(is >> time))
+                break;
+            if (kind == "maxpool")
+                data.maxPoolPerf[args] = time;
+            else
+                data.avgPoolPerf[args] = time;
+        } else {
+            break;
+        }
+    }
+    std::cout << "[ERROR] perf_engine::parsePerfData: corrupted perf data."
+              << std::endl;
+    return 1;
+}
+
+void PerfEngine::mergePerfData(const PerfData &data) {
+    for (auto &kv : data.convPerf)
+        convPerf[kv.first] = kv.second;
+    for (auto &kv : data.matmulPerf)
+        matmulPerf[kv.first] = kv.second;
+    for (auto &kv : data.maxPoolPerf)
+        maxPoolPerf[kv.first] = kv.second;
+    for (auto &kv : data.avgPoolPerf)
+        avgPoolPerf[kv.first] = kv.second;
+}
+
 } // namespace tpm
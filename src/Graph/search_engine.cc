@@ -1,7 +1,19 @@
 #include "search_engine.h"
+#include "bounded_queue.h"
 #include "perf_engine.h"
+#include "rule_stats.h"
+#include "serializer.h"
+#include "trace.h"
 #include <algorithm>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <fstream>
 #include <iostream>
+#include <numeric>
+#include <random>
+#include <sstream>
+#include <thread>
 #include <unordered_set>
 
 namespace tpm {
@@ -15,6 +27,27 @@ SearchEngine::SearchEngine() {
     auto mdenv = getenv("PET_MUTATION_DEPTH");
     if (mdenv != nullptr)
         MUTATION_MDEPTH = atoi(mdenv);
+    auto stenv = getenv("PET_MUTATION_STRATEGY");
+    if (stenv != nullptr && std::string(stenv) == "evolution")
+        mutationStrategy = EvolutionStrategy;
+    auto bgenv = getenv("PET_MUTATION_BUDGET");
+    if (bgenv != nullptr)
+        MUTATION_BUDGET = atoi(bgenv);
+    auto thenv = getenv("PET_MUTATION_THREADS");
+    if (thenv != nullptr)
+        MUTATION_THREADS = atoi(thenv);
+    auto ckenv = getenv("PET_CHECKPOINT_FILE");
+    if (ckenv != nullptr)
+        checkpointFile = ckenv;
+    auto cbenv = getenv("PET_COST_BUDGET");
+    if (cbenv != nullptr) {
+        enableCostBudget = true;
+        if (atof(cbenv) > 0)
+            negligibleShare = atof(cbenv);
+    }
+    defaultMutationDepth = MUTATION_DEPTH;
+    defaultMutationSize = MUTATION_SIZE;
+    defaultGraphSize = GRAPH_SIZE;
 }
 
 SearchEngine::~SearchEngine() {}
@@ -46,10 +79,22 @@ int SearchEngine::MetaGraph::print() {
 
 int SearchEngine::run(const std::shared_ptr<SubGraph> &graph,
                       std::shared_ptr<SubGraph> &bestGraph) {
+    TraceScope scope("SearchEngine::run");
+    scope.arg("ops", graph->getOperators().size());
     int err = 0;
     double t = 0;
+    if (!checkpointFile.empty()) {
+        std::ifstream fin(checkpointFile);
+        if (fin.good() && loadCheckpoint(checkpointFile) == 0)
+            std::cout << "Resume from checkpoint: " << checkpointFile
+                      << std::endl;
+    }
     t = getPerf(graph, true);
     std::cout << "Origin Perf: " << t << std::endl;
+    baselinePerf = t;
+    defaultMutationDepth = MUTATION_DEPTH;
+    defaultMutationSize = MUTATION_SIZE;
+    defaultGraphSize = GRAPH_SIZE;
     graph->printBrief();
     // Partition
     std::vector<std::shared_ptr<SubGraph>> parts;
@@ -60,8 +105,34 @@ int SearchEngine::run(const std::shared_ptr<SubGraph> &graph,
     int pid = 0;
     for (auto &p : parts) {
         std::cout << "Partition: " << pid << std::endl;
+        TraceScope partScope("SearchEngine::searchPartition");
+        partScope.arg("pid", pid).arg("hash", p->getHash());
+        auto partKey = std::make_pair(p->getCanonicalHash(), pid);
+        auto finished = savedParts.find(partKey);
+        std::vector<std::shared_ptr<SubGraph>> restored;
+        if (finished != savedParts.end() &&
+            loadGraphs(finished->second, p.get(), restored) == 0 &&
+            restored.size() == 1) {
+            std::cout << "Partition restored from checkpoint." << std::endl;
+            bestParts.emplace_back(restored[0]);
+            pid++;
+            continue;
+        }
+        if (enableCostBudget && baselinePerf > 0) {
+            if (isNegligible(p)) {
+                std::cout << "Partition skipped: negligible cost." << std::endl;
+                bestParts.emplace_back(p);
+                pid++;
+                continue;
+            }
+            setBudget(getPerf(p) / baselinePerf * parts.size());
+        }
         std::vector<std::shared_ptr<SubGraph>> res;
+        // passes are credited once per partition, so they run once too
+        RuleStats::getInstance().beginPartition();
         err = search(p, res);
+        RuleStats::getInstance().endPartition();
+        resetBudget();
         if (err) {
             return 1;
         }
@@ -73,6 +144,16 @@ int SearchEngine::run(const std::shared_ptr<SubGraph> &graph,
         }
         std::sort(candidates.begin(), candidates.end(), Candidate::cmp);
         bestParts.emplace_back(candidates[0].graph);
+        creditRules(candidates[0].graph,
+                    std::max(getPerf(p) - candidates[0].perf, 0.0));
+        SavedGraphs entry;
+        if (!checkpointFile.empty() &&
+            saveGraphs(p.get(), {candidates[0].graph}, entry) == 0) {
+            savedParts[partKey] = entry;
+            saveCheckpoint(checkpointFile);
+        }
+        if (!RuleStats::getInstance().getPath().empty())
+            RuleStats::getInstance().save(RuleStats::getInstance().getPath());
         pid++;
     }
     for (auto p : bestParts) {
@@ -170,6 +251,8 @@ int SearchEngine::split(const std::shared_ptr<SubGraph> &graph,
 int SearchEngine::searchDfs(
     const std::shared_ptr<MetaGraph> &metaGraph,
     std::vector<std::shared_ptr<MetaGraph>> &metaGraphs) {
+    TraceScope scope("SearchEngine::searchDfs");
+    scope.arg("nodes", metaGraph->nodes.size());
     int err = 0;
     metaGraphs.clear();
     int n = metaGraph->nodes.size();
@@ -355,6 +438,8 @@ int SearchEngine::searchDfs(const std::shared_ptr<MetaGraph> &metaGraph,
 
 int SearchEngine::searchBfs(const std::shared_ptr<MetaGraph> &metaGraph,
                             std::vector<Candidate> &candidates) {
+    TraceScope scope("SearchEngine::searchBfs");
+    scope.arg("nodes", metaGraph->nodes.size());
     int err = 0;
     std::cout << "start search bfs." << std::endl;
     candidates.clear();
@@ -363,7 +448,7 @@ int SearchEngine::searchBfs(const std::shared_ptr<MetaGraph> &metaGraph,
     for (auto &node : metaGraph->nodes) {
         std::vector<Candidate> tmp(0);
         std::vector<std::shared_ptr<SubGraph>> mutatedGraphs;
-        if (node.type == 1) {
+        if (node.type == 1 && !isNegligible(node.graph)) {
             err = getMutation(node.graph, mutatedGraphs);
             if (err) {
                 return 1;
@@ -439,12 +524,42 @@ int SearchEngine::isSpecialMutation(Operator *op, int depth) {
     return 0;
 }
 
+bool SearchEngine::isNegligible(const std::shared_ptr<SubGraph> &graph) {
+    if (!enableCostBudget || baselinePerf <= 0) {
+        return false;
+    }
+    return getPerf(graph) < negligibleShare * baselinePerf;
+}
+
+void SearchEngine::setBudget(double ratio) {
+    // one more round for each doubling of the cost share
+    int shift = (int)std::round(std::log2(std::max(ratio, 1e-6)));
+    MUTATION_DEPTH = std::max(
+        1, std::min(defaultMutationDepth + shift, defaultMutationDepth + 2));
+    MUTATION_SIZE = std::max(
+        1, std::min(defaultMutationSize + shift, 2 * defaultMutationSize));
+    GRAPH_SIZE =
+        std::max(1, std::min(defaultGraphSize + shift, 2 * defaultGraphSize));
+    std::cout << "Search budget: depth=" << MUTATION_DEPTH
+              << ", mutation size=" << MUTATION_SIZE
+              << ", graph size=" << GRAPH_SIZE << std::endl;
+}
+
+void SearchEngine::resetBudget() {
+    MUTATION_DEPTH = defaultMutationDepth;
+    MUTATION_SIZE = defaultMutationSize;
+    GRAPH_SIZE = defaultGraphSize;
+}
+
 double SearchEngine::getPerf(const std::shared_ptr<SubGraph> &graph,
                              bool profiling) {
     double time = 0;
     if (profiling)
         puts("\n========== PET graph getPerf ============");
     for (auto op : graph->getOperators()) {
+        TraceScope scope("Operator::perf");
+        if (scope.isActive())
+            scope.arg("op", op->toString());
         double t = op->perf(perfEngine.get(), 200, 200);
         if (profiling) {
             op->print();
@@ -465,7 +580,10 @@ int SearchEngine::getMutation(
     std::vector<std::shared_ptr<SubGraph>> &mutatedGraphs) {
     // return archived mutation if existed.
     uint64_t graphHash = graph->getHash();
+    TraceScope scope("SearchEngine::getMutation");
+    scope.arg("hash", graphHash);
     if (mutationArchive.find(graphHash) != mutationArchive.end()) {
+        scope.arg("archived", 1);
         auto &archive = mutationArchive[graphHash];
         mutatedGraphs.clear();
         for (auto g : archive) {
@@ -473,6 +591,14 @@ int SearchEngine::getMutation(
         }
         return 0;
     }
+    // mutations of an equal graph restored from a checkpoint
+    auto saved = savedArchive.find(graph->getCanonicalHash());
+    if (saved != savedArchive.end() &&
+        loadGraphs(saved->second, graph.get(), mutatedGraphs) == 0) {
+        scope.arg("archived", 1);
+        mutationArchive[graphHash] = mutatedGraphs;
+        return 0;
+    }
 
     std::cout << "get Mutation: " << graphHash << std::endl;
     std::vector<Operator *> corpOps;
@@ -566,107 +692,316 @@ int SearchEngine::getMutation(
         f.emplace_back(0);
     }
 
-    for (size_t i = 0;; i++) {
-        if (i >= q.size()) {
-            break;
-        }
-        if (f[i] >= MUTATION_DEPTH) {
+    int err = 0;
+    switch (mutationStrategy) {
+    case EvolutionStrategy:
+        err = searchMutationEvolution(graphHash, mutationSet, q, f);
+        break;
+    default:
+        err = searchMutationBfs(mutationSet, q, f);
+    }
+    if (err) {
+        return 1;
+    }
+
+    // select best MUTATION_SIZE graphs.
+    std::sort(q.begin(), q.end(), Candidate::cmp);
+    mutatedGraphs.clear();
+    for (int i = 0; i < int(q.size()) && i < MUTATION_SIZE; i++) {
+        mutatedGraphs.emplace_back(q[i].graph);
+    }
+
+    // save mutation
+    mutationArchive.emplace(graphHash,
+                            std::vector<std::shared_ptr<SubGraph>>(0));
+    auto &archive = mutationArchive[graphHash];
+    for (auto &g : mutatedGraphs) {
+        archive.emplace_back(g);
+    }
+    if (!checkpointFile.empty()) {
+        SavedGraphs entry;
+        if (saveGraphs(graph.get(), mutatedGraphs, entry) == 0)
+            savedArchive[graph->getCanonicalHash()] = entry;
+    }
+
+    return 0;
+}
+
+// a compute op together with the tensors it connects, which stays the same
+// when the op is copied into larger graphs
+static uint64_t opSignature(const Operator *op) {
+    uint64_t ret = hashCombine(op->getHash(), op->getType());
+    for (auto t : op->getInputs())
+        ret = hashCombine(ret, t->getHash());
+    for (auto t : op->getOutputs())
+        ret = hashCombine(ret, t->getHash());
+    return ret;
+}
+
+void SearchEngine::creditRules(const std::shared_ptr<SubGraph> &best,
+                               double gain) {
+    std::unordered_set<std::string> rules;
+    for (auto op : best->getOperators()) {
+        if (!op->isComputeOp())
             continue;
+        auto it = mutationOrigins.find(opSignature(op));
+        if (it != mutationOrigins.end())
+            rules.insert(it->second.begin(), it->second.end());
+    }
+    for (auto &rule : rules)
+        RuleStats::getInstance().recordHit(rule, gain);
+}
+
+int SearchEngine::generateMutation(
+    Generator *engine, const std::shared_ptr<SubGraph> &graph, int depth,
+    int maxDepth, std::unordered_set<uint64_t> &mutationSet, std::mutex *lock,
+    std::vector<std::pair<std::shared_ptr<SubGraph>, int>> &children) {
+    std::vector<Operator *> corpOps, restOps;
+    for (auto op : graph->getOperators()) {
+        if (op->isComputeOp()) {
+            corpOps.emplace_back(op);
+        } else {
+            restOps.emplace_back(op);
         }
+    }
+    if (corpOps.size() == 0) {
+        std::cout << "[ERROR] search_engine::getMutation: search graph "
+                     "have no compute ops."
+                  << std::endl;
+        return 1;
+    }
+    if (corpOps.size() > 1) {
+        std::cout << "[ERROR] search_engine::getMutation: search graph "
+                     "have multiple compute ops."
+                  << std::endl;
+        return 1;
+    }
+    auto corp = std::make_shared<SubGraph>(corpOps);
+    std::vector<SubGraph *> mutation;
+    engine->run(corp.get(), mutation, MUTATION_MDEPTH);
+    // a mutant of a mutant inherits the rules of its parent
+    std::vector<std::string> parentRules;
+    if (lock != nullptr)
+        lock->lock();
+    auto parent = mutationOrigins.find(opSignature(corpOps[0]));
+    if (parent != mutationOrigins.end())
+        parentRules = parent->second;
+    if (lock != nullptr)
+        lock->unlock();
+    auto &mutantRules = engine->getMutantRules();
 
+    for (size_t i = 0, iEnd = mutation.size(); i < iEnd; ++i) {
+        auto tmpGraph = mutation[i];
         corpOps.clear();
-        restOps.clear();
-        for (auto op : q[i].graph->getOperators()) {
+        for (auto op : tmpGraph->getOperators()) {
             if (op->isComputeOp()) {
                 corpOps.emplace_back(op);
-            } else {
-                restOps.emplace_back(op);
             }
         }
         if (corpOps.size() == 0) {
-            std::cout << "[ERROR] search_engine::getMutation: search graph "
+            std::cout << "[ERROR] search_engine::getMutation: mutation graph "
                          "have no compute ops."
                       << std::endl;
             return 1;
         }
-        if (corpOps.size() > 1) {
-            std::cout << "[ERROR] search_engine::getMutation: search graph "
-                         "have multiple compute ops."
-                      << std::endl;
-            return 1;
-        }
-        corp = std::make_shared<SubGraph>(corpOps);
-        mutation.clear();
-        mutationEngine->run(corp.get(), mutation, MUTATION_MDEPTH);
 
-        for (auto tmpGraph : mutation) {
-            corpOps.clear();
-            for (auto op : tmpGraph->getOperators()) {
-                if (op->isComputeOp()) {
-                    corpOps.emplace_back(op);
+        int nextDepth = maxDepth;
+        if (corpOps.size() == 1) {
+            auto computeOp = corpOps[0];
+            if (computeOp->getType() == Operator::Conv) {
+                auto mutationHash = getMutationHash(computeOp);
+                if (lock != nullptr)
+                    lock->lock();
+                bool inserted = mutationSet.emplace(mutationHash).second;
+                if (lock != nullptr)
+                    lock->unlock();
+                if (!inserted) {
+                    continue;
+                }
+                // Special mutation, such as 5 depth mutation.
+                if (isSpecialMutation(computeOp, depth)) {
+                    nextDepth = depth;
+                } else {
+                    nextDepth = depth + 1;
                 }
             }
-            if (corpOps.size() == 0) {
-                std::cout
-                    << "[ERROR] search_engine::getMutation: mutation graph "
-                       "have no compute ops."
-                    << std::endl;
-                return 1;
-            }
+        }
 
-            int nextDepth;
-            if (corpOps.size() == 1) {
-                computeOp = corpOps[0];
-                if (computeOp->getType() == Operator::Conv) {
-                    mutationHash = getMutationHash(computeOp);
-                    if (mutationSet.find(mutationHash) != mutationSet.end()) {
-                        continue;
-                    }
-                    mutationSet.emplace(mutationHash);
-                    // Special mutation, such as 5 depth mutation.
-                    if (isSpecialMutation(computeOp, f[i])) {
-                        nextDepth = f[i];
-                    } else {
-                        nextDepth = f[i] + 1;
-                    }
-                }
-                if (computeOp->getType() == Operator::Matmul) {
-                    nextDepth = MUTATION_DEPTH;
+        if (i < mutantRules.size()) {
+            auto rules = parentRules;
+            rules.emplace_back(mutantRules[i]);
+            if (lock != nullptr)
+                lock->lock();
+            for (auto op : corpOps)
+                mutationOrigins[opSignature(op)] = rules;
+            if (lock != nullptr)
+                lock->unlock();
+        }
+
+        corpOps.clear();
+        for (auto op : tmpGraph->getOperators()) {
+            corpOps.emplace_back(op);
+        }
+        for (auto op : restOps) {
+            corpOps.emplace_back(op);
+        }
+        children.emplace_back(std::make_shared<SubGraph>(corpOps), nextDepth);
+    }
+    return 0;
+}
+
+int SearchEngine::expandMutation(const Candidate &candidate, int depth,
+                                 int maxDepth,
+                                 std::unordered_set<uint64_t> &mutationSet,
+                                 std::vector<Candidate> &q,
+                                 std::vector<int> &f) {
+    std::vector<std::pair<std::shared_ptr<SubGraph>, int>> children;
+    if (generateMutation(mutationEngine.get(), candidate.graph, depth,
+                         maxDepth, mutationSet, nullptr, children)) {
+        return 1;
+    }
+    for (auto &child : children) {
+        q.emplace_back(child.first, getPerf(child.first));
+        f.emplace_back(child.second);
+    }
+    return 0;
+}
+
+// Expand all candidates level by level until MUTATION_DEPTH as a pipeline:
+// generator threads expand candidates and push the new ones to a bounded
+// queue, while this thread profiles them and keeps the best ones. With one
+// generator thread candidates are expanded in the same order as a plain BFS.
+int SearchEngine::searchMutationBfs(std::unordered_set<uint64_t> &mutationSet,
+                                    std::vector<Candidate> &q,
+                                    std::vector<int> &f) {
+    using Item = std::pair<std::shared_ptr<SubGraph>, int>;
+    int nThreads = std::max(1, MUTATION_THREADS);
+    while ((int)workerEngines.size() < nThreads - 1) {
+        workerEngines.emplace_back(mutationEngine->makeSibling());
+    }
+
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::deque<Item> work;
+    int active = 0;
+    bool failed = false;
+    for (size_t i = 0; i < q.size(); i++) {
+        if (f[i] < MUTATION_DEPTH) {
+            work.emplace_back(q[i].graph, f[i]);
+        }
+    }
+    BoundedQueue<Item> produced(MUTATION_QUEUE_SIZE);
+
+    // generation stage
+    auto generate = [&](Generator *engine) {
+        while (true) {
+            Item item;
+            {
+                std::unique_lock<std::mutex> lock(mtx);
+                cv.wait(lock,
+                        [&] { return failed || !work.empty() || active == 0; });
+                if (failed || work.empty()) {
+                    break;
                 }
+                item = work.front();
+                work.pop_front();
+                active++;
             }
-            if (corpOps.size() > 1) {
-                nextDepth = MUTATION_DEPTH;
-            }
-
-            corpOps.clear();
-            for (auto op : tmpGraph->getOperators()) {
-                corpOps.emplace_back(op);
+            std::vector<Item> children;
+            int err = generateMutation(engine, item.first, item.second,
+                                       MUTATION_DEPTH, mutationSet, &mtx,
+                                       children);
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                active--;
+                failed |= err != 0;
+                for (auto &child : children) {
+                    if (child.second < MUTATION_DEPTH) {
+                        work.emplace_back(child);
+                    }
+                }
             }
-            for (auto op : restOps) {
-                corpOps.emplace_back(op);
+            cv.notify_all();
+            for (auto &child : children) {
+                produced.push(child);
             }
-            auto candidateGraph = std::make_shared<SubGraph>(corpOps);
-            auto candidatePerf = getPerf(candidateGraph);
-            q.emplace_back(candidateGraph, candidatePerf);
-            f.emplace_back(nextDepth);
         }
+        cv.notify_all();
+    };
+    std::vector<std::thread> generators;
+    for (int i = 0; i < nThreads; i++) {
+        generators.emplace_back(generate, i == 0 ? mutationEngine.get()
+                                                 : workerEngines[i - 1].get());
     }
+    std::thread closer([&] {
+        for (auto &t : generators) {
+            t.join();
+        }
+        produced.close();
+    });
 
-    // select best MUTATION_SIZE graphs.
-    std::sort(q.begin(), q.end(), Candidate::cmp);
-    mutatedGraphs.clear();
-    for (int i = 0; i < int(q.size()) && i < MUTATION_SIZE; i++) {
-        mutatedGraphs.emplace_back(q[i].graph);
+    // profiling and selection stage
+    std::vector<size_t> idx;
+    auto select = [&](size_t size) {
+        idx.resize(q.size());
+        std::iota(idx.begin(), idx.end(), 0);
+        std::stable_sort(idx.begin(), idx.end(), [&](size_t a, size_t b) {
+            return Candidate::cmp(q[a], q[b]);
+        });
+        std::vector<Candidate> nq;
+        std::vector<int> nf;
+        for (size_t i = 0; i < idx.size() && i < size; i++) {
+            nq.emplace_back(q[idx[i]]);
+            nf.emplace_back(f[idx[i]]);
+        }
+        q.swap(nq);
+        f.swap(nf);
+    };
+    Item item;
+    while (produced.pop(item)) {
+        q.emplace_back(item.first, getPerf(item.first));
+        f.emplace_back(item.second);
+        if ((int)q.size() > 4 * MUTATION_SIZE) {
+            select(MUTATION_SIZE);
+        }
     }
+    closer.join();
+    return failed ? 1 : 0;
+}
 
-    // save mutation
-    mutationArchive.emplace(graphHash,
-                            std::vector<std::shared_ptr<SubGraph>>(0));
-    auto &archive = mutationArchive[graphHash];
-    for (auto &g : mutatedGraphs) {
-        archive.emplace_back(g);
+// Expand at most MUTATION_BUDGET candidates chosen by tournament selection,
+// so that a promising chain can go deeper than MUTATION_DEPTH without
+// expanding every shallow candidate.
+int SearchEngine::searchMutationEvolution(
+    uint64_t seed, std::unordered_set<uint64_t> &mutationSet,
+    std::vector<Candidate> &q, std::vector<int> &f) {
+    int maxDepth = 2 * MUTATION_DEPTH;
+    std::mt19937 rng(seed);
+    std::vector<bool> expanded(q.size(), false);
+    for (int budget = MUTATION_BUDGET; budget > 0; budget--) {
+        std::vector<size_t> open;
+        for (size_t i = 0; i < q.size(); i++) {
+            if (!expanded[i] && f[i] < maxDepth) {
+                open.emplace_back(i);
+            }
+        }
+        if (open.empty()) {
+            break;
+        }
+        size_t best = open[rng() % open.size()];
+        for (int i = 1; i < TOURNAMENT_SIZE; i++) {
+            size_t x = open[rng() % open.size()];
+            if (Candidate::cmp(q[x], q[best])) {
+                best = x;
+            }
+        }
+        expanded[best] = true;
+        auto candidate = q[best];
+        if (expandMutation(candidate, f[best], maxDepth, mutationSet, q, f)) {
+            return 1;
+        }
+        expanded.resize(q.size(), false);
     }
-
     return 0;
 }
 
@@ -717,6 +1052,7 @@ uint64_t SearchEngine::getMutationHash(const Operator *op) {
 
 std::vector<std::shared_ptr<SubGraph>>
 SearchEngine::partition(const std::shared_ptr<SubGraph> &graph) {
+    TraceScope scope("SearchEngine::partition");
     // reversed DFS post-order is topo-order
     std::unordered_map<const Operator *, int> preOrder, postOrder;
     std::vector<Operator *> ops;
@@ -926,4 +1262,191 @@ std::shared_ptr<PerfEngine> SearchEngine::exportPerfEngine() {
     return perfEngine;
 }
 
+std::shared_ptr<Generator> SearchEngine::exportMutationEngine() {
+    return mutationEngine;
+}
+
+int SearchEngine::saveGraphs(
+    SubGraph *source, const std::vector<std::shared_ptr<SubGraph>> &graphs,
+    SavedGraphs &saved) {
+    saved.inputs.clear();
+    saved.outputs.clear();
+    saved.graphs.clear();
+    for (auto t : source->getInputs())
+        saved.inputs.emplace_back(t->getHash());
+    for (auto t : source->getOutputs())
+        saved.outputs.emplace_back(t->getHash());
+    for (auto &g : graphs) {
+        std::ostringstream os;
+        if (Serializer::saveGraph(os, g.get()))
+            return 1;
+        saved.graphs.emplace_back(os.str());
+    }
+    return 0;
+}
+
+int SearchEngine::loadGraphs(const SavedGraphs &saved, SubGraph *target,
+                             std::vector<std::shared_ptr<SubGraph>> &graphs) {
+    auto &inputs = target->getInputs(), &outputs = target->getOutputs();
+    if (inputs.size() != saved.inputs.size() ||
+        outputs.size() != saved.outputs.size())
+        return 1;
+    std::unordered_map<uint64_t, uint64_t> bind;
+    for (size_t i = 0; i < inputs.size(); ++i)
+        bind[saved.inputs[i]] = inputs[i]->getHash();
+    for (size_t i = 0; i < outputs.size(); ++i)
+        bind[saved.outputs[i]] = outputs[i]->getHash();
+    std::vector<std::shared_ptr<SubGraph>> ret;
+    for (auto &text : saved.graphs) {
+        std::istringstream is(text);
+        auto g = Serializer::loadGraph(is, bind);
+        if (g == nullptr)
+            return 1;
+        ret.emplace_back(g);
+    }
+    graphs = ret;
+    return 0;
+}
+
+static void saveHashes(std::ostream &os, const std::vector<uint64_t> &hashes) {
+    os << hashes.size();
+    for (auto h : hashes)
+        os << " " << h;
+}
+
+static bool loadHashes(std::istream &is, std::vector<uint64_t> &hashes) {
+    size_t n;
+    if (!(is >> n))
+        return false;
+    hashes.resize(n);
+    for (size_t i = 0; i < n; ++i)
+        if (!(is >> hashes[i]))
+            return false;
+    return true;
+}
+
+// inputs outputs #graphs
+// graph ...
+static void saveEntry(std::ostream &os, const std::vector<uint64_t> &inputs,
+                      const std::vector<uint64_t> &outputs,
+                      const std::vector<std::string> &graphs) {
+    saveHashes(os, inputs);
+    os << " ";
+    saveHashes(os, outputs);
+    os << " " << graphs.size() << "\n";
+    for (auto &text : graphs)
+        os << text;
+}
+
+static bool loadEntry(std::istream &is, std::vector<uint64_t> &inputs,
+                      std::vector<uint64_t> &outputs,
+                      std::vector<std::string> &graphs) {
+    size_t n;
+    if (!loadHashes(is, inputs) || !loadHashes(is, outputs) || !(is >> n))
+        return false;
+    graphs.resize(n);
+    for (size_t i = 0; i < n; ++i)
+        if (!Serializer::readGraph(is, graphs[i]))
+            return false;
+    return true;
+}
+
+// The checkpoint is written to a temporary file and renamed, so a crash
+// while saving keeps the previous checkpoint. Archived and finished graphs
+// are keyed by canonical hashes, which stay the same after a restart.
+int SearchEngine::saveCheckpoint(const std::string &file) {
+    TraceScope scope("SearchEngine::saveCheckpoint");
+    std::string tmpFile = file + ".tmp";
+    std::ofstream fout(tmpFile);
+    if (!fout) {
+        std::cout << "[ERROR] search_engine::saveCheckpoint: cannot open "
+                  << tmpFile << std::endl;
+        return 1;
+    }
+    fout << "PET_CHECKPOINT 2\n";
+    perfEngine->savePerfData(fout);
+    // sorted, so that a checkpoint is saved as the same text
+    std::map<uint64_t, const SavedGraphs *> archive;
+    for (auto &kv : savedArchive)
+        archive[kv.first] = &kv.second;
+    fout << "archive " << archive.size() << "\n";
+    for (auto &kv : archive) {
+        fout << kv.first << " ";
+        saveEntry(fout, kv.second->inputs, kv.second->outputs,
+                  kv.second->graphs);
+    }
+    fout << "parts " << savedParts.size() << "\n";
+    for (auto &kv : savedParts) {
+        fout << kv.first.first << " " << kv.first.second << " ";
+        saveEntry(fout, kv.second.inputs, kv.second.outputs,
+                  kv.second.graphs);
+    }
+    RuleStats::getInstance().saveData(fout);
+    fout.close();
+    if (!fout || std::rename(tmpFile.c_str(), file.c_str()) != 0) {
+        std::cout << "[ERROR] search_engine::saveCheckpoint: cannot write "
+                  << file << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+// Everything is parsed before any of it is used, so a corrupted checkpoint
+// leaves the engine as it was.
+int SearchEngine::loadCheckpoint(const std::string &file) {
+    std::ifstream fin(file);
+    std::string tag;
+    int version;
+    if (!(fin >> tag >> version) || tag != "PET_CHECKPOINT" || version != 2) {
+        std::cout << "[ERROR] search_engine::loadCheckpoint: invalid file "
+                  << file << std::endl;
+        return 1;
+    }
+    PerfEngine::PerfData perfData;
+    std::unordered_map<uint64_t, SavedGraphs> archive;
+    std::map<std::pair<uint64_t, int>, SavedGraphs> parts;
+    std::map<std::string, RuleStats::Entry> rules;
+    auto corrupted = [&file]() {
+        std::cout << "[ERROR] search_engine::loadCheckpoint: corrupted file "
+                  << file << std::endl;
+        return 1;
+    };
+    if (PerfEngine::parsePerfData(fin, perfData))
+        return corrupted();
+    size_t n;
+    uint64_t hash;
+    int pid;
+    if (!(fin >> tag >> n) || tag != "archive")
+        return corrupted();
+    for (size_t i = 0; i < n; i++) {
+        if (!(fin >> hash))
+            return corrupted();
+        auto &entry = archive[hash];
+        if (!loadEntry(fin, entry.inputs, entry.outputs, entry.graphs))
+            return corrupted();
+    }
+    if (!(fin >> tag >> n) || tag != "parts")
+        return corrupted();
+    for (size_t i = 0; i < n; i++) {
+        if (!(fin >> hash >> pid))
+            return corrupted();
+        auto &entry = parts[std::make_pair(hash, pid)];
+        if (!loadEntry(fin, entry.inputs, entry.outputs, entry.graphs) ||
+            entry.graphs.size() != 1)
+            return corrupted();
+    }
+    // checkpoints written before the rule stats have no rules section
+    fin >> std::ws;
+    if (fin.peek() != EOF && RuleStats::parseData(fin, rules))
+        return corrupted();
+
+    perfEngine->mergePerfData(perfData);
+    for (auto &kv : archive)
+        savedArchive[kv.first] = kv.second;
+    for (auto &kv : parts)
+        savedParts[kv.first] = kv.second;
+    RuleStats::getInstance().mergeData(rules);
+    return 0;
+}
+
 } // namespace tpm
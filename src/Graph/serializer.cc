@@ -0,0 +1,496 @@
+#include "serializer.h"
+#include <sstream>
+
+namespace tpm {
+
+void Serializer::saveDim(std::ostream &os, const Dim &dim) {
+    os << dim.size();
+    for (auto x : dim)
+        os << " " << x;
+}
+
+bool Serializer::loadDim(std::istream &is, Dim &dim) {
+    size_t n;
+    if (!(is >> n))
+        return false;
+    dim.resize(n);
+    for (size_t i = 0; i < n; ++i)
+        if (!(is >> dim[i]))
+            return false;
+    return true;
+}
+
+// tensor: hash dtype type dims penalty, the hash is only its id in the text
+void Serializer::saveTensor(std::ostream &os, Tensor *tensor) {
+    os << tensor->getHash() << " " << tensor->getDType() << " "
+       << tensor->getType() << " ";
+    saveDim(os, tensor->getDims());
+    os << " ";
+    saveDim(os, tensor->getPenalty());
+}
+
+Tensor *Serializer::loadTensor(std::istream &is, uint64_t &savedHash) {
+    uint64_t hash;
+    int dtype, type;
+    Dim dims, penalty;
+    if (!(is >> hash >> dtype >> type) || !loadDim(is, dims) ||
+        !loadDim(is, penalty))
+        return nullptr;
+    auto tensor = new Tensor(dims, (Tensor::TensorType)type,
+                             (Tensor::DataType)dtype);
+    tensor->setPenalty(penalty);
+    savedHash = hash;
+    return tensor;
+}
+
+void Serializer::savePerm(std::ostream &os, const Perm &perm) {
+    os << perm.size();
+    for (size_t i = 0, iEnd = perm.size(); i < iEnd; ++i) {
+        os << " ";
+        saveDim(os, perm[i].getVec());
+    }
+}
+
+bool Serializer::loadPerm(std::istream &is, std::vector<PermItem> &perm) {
+    size_t n;
+    if (!(is >> n))
+        return false;
+    perm.clear();
+    for (size_t i = 0; i < n; ++i) {
+        Dim item;
+        if (!loadDim(is, item))
+            return false;
+        perm.emplace_back(item);
+    }
+    return true;
+}
+
+static void saveOptTensor(std::ostream &os, Tensor *tensor) {
+    if (tensor == nullptr) {
+        os << " 0";
+        return;
+    }
+    os << " 1 ";
+    Serializer::saveDim(os, tensor->getDims());
+}
+
+// tensors pushed to owned are freed by the caller
+static bool loadOptTensor(std::istream &is, Tensor *&tensor,
+                          TensorVec *owned) {
+    int has;
+    tensor = nullptr;
+    if (!(is >> has))
+        return false;
+    if (has == 0)
+        return true;
+    Dim dims;
+    if (!Serializer::loadDim(is, dims))
+        return false;
+    tensor = new Tensor(dims, Tensor::Weight);
+    if (owned != nullptr)
+        owned->emplace_back(tensor);
+    return true;
+}
+
+int Serializer::saveOpAttrs(std::ostream &os, Operator *op) {
+    switch (op->getType()) {
+    case Operator::Conv: {
+        auto conv = (ConvOp *)op;
+        os << " " << conv->getPh() << " " << conv->getPw() << " "
+           << conv->getSh() << " " << conv->getSw() << " " << conv->getDh()
+           << " " << conv->getDw() << " " << conv->getAct();
+        saveOptTensor(os, conv->getBias());
+        break;
+    }
+    case Operator::Matmul: {
+        auto matmul = (MatmulOp *)op;
+        os << " " << matmul->getTransA() << " " << matmul->getTransB() << " "
+           << matmul->getAct();
+        saveOptTensor(os, matmul->getBias());
+        break;
+    }
+    case Operator::Pad:
+        os << " ";
+        saveDim(os, ((PadOp *)op)->getBegin());
+        os << " ";
+        saveDim(os, ((PadOp *)op)->getEnd());
+        break;
+    case Operator::Slice:
+        os << " ";
+        saveDim(os, ((SliceOp *)op)->getBegin());
+        os << " ";
+        saveDim(os, ((SliceOp *)op)->getEnd());
+        break;
+    case Operator::Concat:
+        os << " " << ((ConcatOp *)op)->getDim();
+        break;
+    case Operator::Split: {
+        auto split = (SplitOp *)op;
+        os << " " << split->getDim() << " " << split->getNum() << " ";
+        saveDim(os, split->getSizes());
+        break;
+    }
+    case Operator::Transpose: {
+        auto trans = (TransposeOp *)op;
+        os << " " << trans->getFactor() << " " << trans->getType() << " "
+           << trans->getPos() << " " << trans->getPaddingSize().first << " "
+           << trans->getPaddingSize().second << " ";
+        savePerm(os, trans->getBefore());
+        os << " ";
+        savePerm(os, trans->getAfter());
+        break;
+    }
+    case Operator::Extend:
+        os << " " << ((ExtendOp *)op)->getDim() << " "
+           << ((ExtendOp *)op)->getNum();
+        break;
+    case Operator::MaxPool: {
+        auto pool = (MaxPoolOp *)op;
+        os << " " << pool->getKh() << " " << pool->getKw() << " "
+           << pool->getDh() << " " << pool->getDw() << " " << pool->getPh()
+           << " " << pool->getPw() << " " << pool->getSh() << " "
+           << pool->getSw();
+        break;
+    }
+    case Operator::AvgPool: {
+        auto pool = (AvgPoolOp *)op;
+        os << " " << pool->getKh() << " " << pool->getKw() << " "
+           << pool->getPh() << " " << pool->getPw() << " " << pool->getSh()
+           << " " << pool->getSw();
+        break;
+    }
+    case Operator::BatchNorm: {
+        auto bn = (BatchNormOp *)op;
+        os << " " << bn->getEpsilon() << " " << bn->getMomentum();
+        saveOptTensor(os, bn->getScale());
+        saveOptTensor(os, bn->getBias());
+        saveOptTensor(os, bn->getMean());
+        saveOptTensor(os, bn->getVar());
+        break;
+    }
+    case Operator::Pow:
+        os << " " << ((PowOp *)op)->getPow();
+        break;
+    case Operator::Gather:
+        os << " " << ((GatherOp *)op)->getAxis();
+        break;
+    case Operator::ReduceMean:
+        os << " " << ((ReduceMeanOp *)op)->getAxis();
+        break;
+    case Operator::Softmax:
+        os << " " << ((SoftmaxOp *)op)->getAxis();
+        break;
+    case Operator::Activation:
+        os << " " << ((ActivationOp *)op)->getActType();
+        break;
+    case Operator::Add:
+    case Operator::Sub:
+    case Operator::Mul:
+    case Operator::Div:
+    case Operator::Reshape:
+    case Operator::Identity:
+        break;
+    default:
+        std::cout << "[ERROR] serializer::saveOpAttrs: unsupported op type "
+                  << op->getType() << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+Operator *Serializer::loadOp(std::istream &is, int type,
+                             const TensorVec &inputs, const TensorVec &outputs,
+                             TensorVec &extra, TensorVec &shared) {
+    Operator *op = nullptr;
+    switch (type) {
+    case Operator::Conv: {
+        int ph, pw, sh, sw, dh, dw, act;
+        Tensor *bias;
+        if (!(is >> ph >> pw >> sh >> sw >> dh >> dw >> act) ||
+            !loadOptTensor(is, bias, &shared))
+            return nullptr;
+        // bias is shared by the clones of conv
+        op = new ConvOp(ph, pw, sh, sw, dh, dw, bias, (Operator::ActType)act);
+        break;
+    }
+    case Operator::Matmul: {
+        int transA, transB, act;
+        Tensor *bias;
+        if (!(is >> transA >> transB >> act) ||
+            !loadOptTensor(is, bias, &shared))
+            return nullptr;
+        op = new MatmulOp(transA, transB, bias, (Operator::ActType)act);
+        break;
+    }
+    case Operator::Pad:
+    case Operator::Slice: {
+        Dim begin, end;
+        if (!loadDim(is, begin) || !loadDim(is, end))
+            return nullptr;
+        if (type == Operator::Pad)
+            op = new PadOp(begin, end);
+        else
+            op = new SliceOp(begin, end);
+        break;
+    }
+    case Operator::Concat: {
+        int dim;
+        if (!(is >> dim))
+            return nullptr;
+        op = new ConcatOp(dim);
+        break;
+    }
+    case Operator::Split: {
+        int dim, num;
+        Dim sizes;
+        if (!(is >> dim >> num) || !loadDim(is, sizes))
+            return nullptr;
+        if (num == -1)
+            op = new SplitOp(dim, sizes);
+        else
+            op = new SplitOp(dim, num, sizes);
+        break;
+    }
+    case Operator::Transpose: {
+        int factor, transType, transPos, paddingH, paddingW;
+        std::vector<PermItem> before, after;
+        if (!(is >> factor >> transType >> transPos >> paddingH >>
+              paddingW) ||
+            !loadPerm(is, before) || !loadPerm(is, after))
+            return nullptr;
+        auto trans = new TransposeOp(inputs[0], outputs[0], Perm(before),
+                                     Perm(after), factor,
+                                     (TransposeOp::TransType)transType);
+        trans->setPos((TransposeOp::TransPos)transPos);
+        trans->setPaddingSize(paddingH, paddingW);
+        return trans;
+    }
+    case Operator::Extend: {
+        int dim, num;
+        if (!(is >> dim >> num))
+            return nullptr;
+        op = new ExtendOp(dim, num);
+        break;
+    }
+    case Operator::MaxPool: {
+        int kh, kw, dh, dw, ph, pw, sh, sw;
+        if (!(is >> kh >> kw >> dh >> dw >> ph >> pw >> sh >> sw))
+            return nullptr;
+        op = new MaxPoolOp(kh, kw, dh, dw, ph, pw, sh, sw);
+        break;
+    }
+    case Operator::AvgPool: {
+        int kh, kw, ph, pw, sh, sw;
+        if (!(is >> kh >> kw >> ph >> pw >> sh >> sw))
+            return nullptr;
+        op = new AvgPoolOp(kh, kw, ph, pw, sh, sw);
+        break;
+    }
+    case Operator::BatchNorm: {
+        float epsilon, momentum;
+        Tensor *scale, *bias, *mean, *var;
+        if (!(is >> epsilon >> momentum) ||
+            !loadOptTensor(is, scale, &extra) ||
+            !loadOptTensor(is, bias, &extra) ||
+            !loadOptTensor(is, mean, &extra) || !loadOptTensor(is, var, &extra))
+            return nullptr;
+        op = new BatchNormOp(scale, bias, mean, var, epsilon, momentum);
+        break;
+    }
+    case Operator::Pow: {
+        int pow;
+        if (!(is >> pow))
+            return nullptr;
+        op = new PowOp(pow);
+        break;
+    }
+    case Operator::Gather: {
+        int axis;
+        if (!(is >> axis))
+            return nullptr;
+        return new GatherOp(inputs[0], inputs[1], outputs[0], axis);
+    }
+    case Operator::ReduceMean: {
+        int axis;
+        if (!(is >> axis))
+            return nullptr;
+        return new ReduceMeanOp(inputs[0], outputs[0], axis);
+    }
+    case Operator::Softmax: {
+        int axis;
+        if (!(is >> axis))
+            return nullptr;
+        return new SoftmaxOp(inputs[0], outputs[0], axis);
+    }
+    case Operator::Activation: {
+        int act;
+        if (!(is >> act))
+            return nullptr;
+        return new ActivationOp(inputs[0], outputs[0], (Operator::ActType)act);
+    }
+    case Operator::Add:
+        op = new AddOp();
+        break;
+    case Operator::Sub:
+        op = new SubOp();
+        break;
+    case Operator::Mul:
+        op = new MulOp();
+        break;
+    case Operator::Div:
+        op = new DivOp();
+        break;
+    case Operator::Reshape:
+        op = new ReshapeOp();
+        break;
+    case Operator::Identity:
+        op = new IdentityOp();
+        break;
+    default:
+        std::cout << "[ERROR] serializer::loadOp: unsupported op type " << type
+                  << std::endl;
+        return nullptr;
+    }
+    op->setInputs(inputs);
+    op->setOutputs(outputs);
+    return op;
+}
+
+// graph <#tensors> <#ops>
+// t <tensor> ...
+// o <type> <hash> <#inputs> <tensor ids> <#outputs> <tensor ids> <attrs> ...
+int Serializer::saveGraph(std::ostream &os, SubGraph *graph) {
+    std::unordered_map<const Tensor *, int> tensorId;
+    auto &tensors = graph->getTensors();
+    auto &ops = graph->getOperators();
+    os << "graph " << tensors.size() << " " << ops.size() << "\n";
+    for (size_t i = 0, iEnd = tensors.size(); i < iEnd; ++i) {
+        tensorId[tensors[i]] = i;
+        os << "t ";
+        saveTensor(os, tensors[i]);
+        os << "\n";
+    }
+    for (auto op : ops) {
+        os << "o " << op->getType() << " " << op->getHash() << " "
+           << op->getInputs().size();
+        for (auto t : op->getInputs())
+            os << " " << tensorId.at(t);
+        os << " " << op->getOutputs().size();
+        for (auto t : op->getOutputs())
+            os << " " << tensorId.at(t);
+        if (saveOpAttrs(os, op))
+            return 1;
+        os << "\n";
+    }
+    return 0;
+}
+
+std::shared_ptr<SubGraph>
+Serializer::loadGraph(std::istream &is,
+                      const std::unordered_map<uint64_t, uint64_t> &bind) {
+    std::string tag;
+    size_t ntensor, nop;
+    if (!(is >> tag >> ntensor >> nop) || tag != "graph")
+        return nullptr;
+    // extra tensors are copied by the clones of their ops, shared ones are
+    // referred to by the clones and live as long as the graph
+    TensorVec tensors, extra, shared;
+    OpVec ops;
+    bool ok = true;
+    // two tensors with one hash would be merged by SubGraph
+    std::unordered_map<uint64_t, Tensor *> savedHashes;
+    for (size_t i = 0; ok && i < ntensor; ++i) {
+        Tensor *tensor = nullptr;
+        uint64_t hash;
+        if ((is >> tag) && tag == "t")
+            tensor = loadTensor(is, hash);
+        if (tensor == nullptr) {
+            ok = false;
+            break;
+        }
+        tensors.emplace_back(tensor);
+        if (!savedHashes.emplace(hash, tensor).second) {
+            ok = false;
+            break;
+        }
+        auto it = bind.find(hash);
+        if (it != bind.end())
+            tensor->setHash(it->second);
+    }
+    for (size_t i = 0; ok && i < nop; ++i) {
+        int type;
+        uint64_t hash;
+        size_t n;
+        TensorVec inputs, outputs;
+        if (!(is >> tag >> type >> hash) || tag != "o") {
+            ok = false;
+            break;
+        }
+        for (auto vec : {&inputs, &outputs}) {
+            if (!(is >> n)) {
+                ok = false;
+                break;
+            }
+            for (size_t j = 0; ok && j < n; ++j) {
+                size_t id;
+                if (!(is >> id) || id >= tensors.size())
+                    ok = false;
+                else
+                    vec->emplace_back(tensors[id]);
+            }
+        }
+        if (!ok)
+            break;
+        auto op = loadOp(is, type, inputs, outputs, extra, shared);
+        if (op == nullptr) {
+            ok = false;
+        } else {
+            // op hashes come from the attributes, so unlike tensor hashes
+            // they are the same in every process
+            op->setHash(hash);
+            ops.emplace_back(op);
+        }
+    }
+    std::shared_ptr<SubGraph> graph = nullptr;
+    if (ok) {
+        graph = std::shared_ptr<SubGraph>(new SubGraph(ops),
+                                          [shared](SubGraph *g) {
+                                              delete g;
+                                              for (auto tensor : shared)
+                                                  delete tensor;
+                                          });
+    } else {
+        std::cout << "[ERROR] serializer::loadGraph: corrupted graph."
+                  << std::endl;
+        for (auto tensor : shared)
+            delete tensor;
+    }
+    // SubGraph clones ops and tensors
+    for (auto op : ops)
+        delete op;
+    for (auto tensor : tensors)
+        delete tensor;
+    for (auto tensor : extra)
+        delete tensor;
+    return graph;
+}
+
+bool Serializer::readGraph(std::istream &is, std::string &text) {
+    std::string line, tag;
+    size_t ntensor, nop;
+    if (!std::getline(is >> std::ws, line))
+        return false;
+    std::istringstream header(line);
+    if (!(header >> tag >> ntensor >> nop) || tag != "graph")
+        return false;
+    text = line + "\n";
+    for (size_t i = 0; i < ntensor + nop; ++i) {
+        if (!std::getline(is, line))
+            return false;
+        text += line + "\n";
+    }
+    std::istringstream ss(text);
+    return loadGraph(ss) != nullptr;
+}
+
+} // end of namespace tpm
@@ -0,0 +1,29 @@
+#include "strided_loop.h"
+
+namespace tpm {
+
+StridedLoop::StridedLoop(const Dim &dims_, const std::vector<Dim> &strides_)
+    : strides(strides_.size()), total(1) {
+    for (auto &s : strides_)
+        assert(s.size() == dims_.size());
+    for (size_t i = 0, iEnd = dims_.size(); i < iEnd; ++i) {
+        total *= dims_[i];
+        if (dims_[i] == 1)
+            continue;
+        // dim i continues the previous one in every operand
+        auto merge = !dims.empty();
+        for (size_t k = 0; k < strides.size() && merge; ++k)
+            merge = strides[k].back() == (size_t)strides_[k][i] * dims_[i];
+        if (merge) {
+            dims.back() *= dims_[i];
+            for (size_t k = 0; k < strides.size(); ++k)
+                strides[k].back() = strides_[k][i];
+        } else {
+            dims.emplace_back(dims_[i]);
+            for (size_t k = 0; k < strides.size(); ++k)
+                strides[k].emplace_back(strides_[k][i]);
+        }
+    }
+}
+
+} // end of namespace tpm
@@ -1,6 +1,7 @@
 #include "tensor.h"
 #include "common.h"
 #include "operator.h"
+#include "strided_loop.h"
 
 namespace tpm {
 std::pair<Operator *, int> Tensor::getOutputOfWithIndex() {
@@ -13,6 +14,93 @@ std::pair<Operator *, int> Tensor::getOutputOfWithIndex() {
     return {nullptr, -1};
 }
 
+bool Tensor::setView(Tensor *src, const Dim &begin) {
+    auto &srcDims = src->getDims();
+    if (begin.size() != srcDims.size() || dims.size() != srcDims.size())
+        return false;
+    for (size_t i = 0, iEnd = dims.size(); i < iEnd; ++i)
+        if (begin[i] < 0 || begin[i] + dims[i] > srcDims[i])
+            return false;
+    // views of views read the same base
+    auto base = src->viewBase != nullptr ? src->viewBase : src;
+    if (data != nullptr || base == this || base->data == nullptr)
+        return false;
+    auto strides =
+        src->viewBase != nullptr ? src->viewStrides : denseStrides(srcDims);
+    size_t offset = src->viewOffset;
+    for (size_t i = 0, iEnd = begin.size(); i < iEnd; ++i)
+        offset += (size_t)begin[i] * strides[i];
+    resetView();
+    base->numViews++;
+    viewBase = base;
+    viewOffset = offset;
+    viewStrides = strides;
+    return true;
+}
+
+bool Tensor::setReshapeView(Tensor *src) {
+    if (src->size() != size())
+        return false;
+    auto base = src->viewBase != nullptr ? src->viewBase : src;
+    if (data != nullptr || base == this || base->data == nullptr)
+        return false;
+    if (src->viewBase != nullptr) {
+        auto &srcDims = src->getDims();
+        auto dense = denseStrides(srcDims);
+        for (size_t i = 0, iEnd = srcDims.size(); i < iEnd; ++i)
+            if (srcDims[i] > 1 && src->viewStrides[i] != dense[i])
+                return false;
+    }
+    auto offset = src->viewOffset;
+    resetView();
+    base->numViews++;
+    viewBase = base;
+    viewOffset = offset;
+    viewStrides = denseStrides(dims);
+    return true;
+}
+
+bool Tensor::setTransposeView(Tensor *src, const std::vector<int> &perm) {
+    auto &srcDims = src->getDims();
+    if (perm.size() != srcDims.size() || dims.size() != srcDims.size())
+        return false;
+    for (size_t i = 0, iEnd = perm.size(); i < iEnd; ++i)
+        if (perm[i] < 0 || perm[i] >= (int)iEnd || dims[i] != srcDims[perm[i]])
+            return false;
+    auto base = src->viewBase != nullptr ? src->viewBase : src;
+    if (data != nullptr || base == this || base->data == nullptr)
+        return false;
+    auto srcStrides =
+        src->viewBase != nullptr ? src->viewStrides : denseStrides(srcDims);
+    Dim strides;
+    for (auto i : perm)
+        strides.emplace_back(srcStrides[i]);
+    auto offset = src->viewOffset;
+    resetView();
+    base->numViews++;
+    viewBase = base;
+    viewOffset = offset;
+    viewStrides = strides;
+    return true;
+}
+
+void Tensor::materialize() {
+    if (viewBase == nullptr)
+        return;
+    assert(viewBase->data != nullptr);
+    auto buf = getAllocator()->alloc(size());
+    auto src = getReadPtr();
+    StridedLoop loop(dims, {denseStrides(dims), viewStrides});
+    auto ss = loop.getInnerStride(1);
+    loop.parallelFor([&](const size_t *offsets, size_t n) {
+        auto dst = buf + offsets[0], from = src + offsets[1];
+        for (size_t j = 0; j < n; ++j)
+            dst[j] = from[j * ss];
+    });
+    resetView();
+    data = buf;
+}
+
 bool Tensor::random_inited;
 int Tensor::random_seed[256 * 16];
 
@@ -0,0 +1,114 @@
+#include "tensor_pool.h"
+#include <cstdlib>
+#include <sys/mman.h>
+
+namespace tpm {
+
+static const size_t hugePageBytes = 2 << 20;
+
+TensorPool &TensorPool::getDefault() {
+    static TensorPool *pool = []() {
+        size_t maxCached = 256 << 20;
+        auto env = getenv("PET_TENSOR_POOL_CACHE");
+        if (env != nullptr)
+            maxCached = (size_t)std::max(atol(env), 0l) << 20;
+        env = getenv("PET_HUGE_PAGES");
+        bool hugePages = env != nullptr && atoi(env) != 0;
+        return new TensorPool(maxCached, hugePages);
+    }();
+    return *pool;
+}
+
+size_t TensorPool::sizeClass(size_t bytes) {
+    if (bytes <= 256)
+        return std::max((bytes + 63) / 64 * 64, (size_t)64);
+    // four classes between two powers of two
+    size_t top = 256;
+    while (top * 2 < bytes)
+        top *= 2;
+    size_t quarter = top / 4;
+    return (bytes + quarter - 1) / quarter * quarter;
+}
+
+void *TensorPool::allocRaw(size_t bytes) {
+    bool huge = hugePages && bytes >= hugePageBytes;
+    void *ptr = nullptr;
+    if (posix_memalign(&ptr, huge ? hugePageBytes : 64, bytes) != 0)
+        return nullptr;
+#ifdef MADV_HUGEPAGE
+    if (huge)
+        madvise(ptr, bytes, MADV_HUGEPAGE);
+#endif
+    return ptr;
+}
+
+VType *TensorPool::alloc(size_t size) {
+    auto bytes = sizeClass(std::max(size, (size_t)1) * sizeof(VType));
+    std::lock_guard<std::mutex> guard(mtx);
+    void *ptr = nullptr;
+    auto it = freeLists.find(bytes);
+    if (it != freeLists.end() && !it->second.empty()) {
+        ptr = it->second.back();
+        it->second.pop_back();
+        stats.cached -= bytes;
+        stats.hits++;
+    } else {
+        ptr = allocRaw(bytes);
+        if (ptr == nullptr) {
+            std::cout << "[ERROR] TensorPool::alloc: cannot allocate "
+                      << bytes << " bytes" << std::endl;
+            return nullptr;
+        }
+    }
+    classes[ptr] = bytes;
+    stats.allocs++;
+    stats.used += bytes;
+    stats.peak = std::max(stats.peak, stats.used);
+    return (VType *)ptr;
+}
+
+void TensorPool::releaseLocked(VType *ptr) {
+    auto it = classes.find(ptr);
+    if (it == classes.end()) {
+        std::cout << "[ERROR] TensorPool::release: buffer not from the pool"
+                  << std::endl;
+        return;
+    }
+    auto bytes = it->second;
+    classes.erase(it);
+    stats.releases++;
+    stats.used -= bytes;
+    if (stats.cached + bytes > maxCached) {
+        free(ptr);
+        return;
+    }
+    freeLists[bytes].emplace_back(ptr);
+    stats.cached += bytes;
+}
+
+void TensorPool::release(VType *ptr) {
+    std::lock_guard<std::mutex> guard(mtx);
+    releaseLocked(ptr);
+}
+
+void TensorPool::release(const std::vector<VType *> &ptrs) {
+    std::lock_guard<std::mutex> guard(mtx);
+    for (auto ptr : ptrs)
+        releaseLocked(ptr);
+}
+
+void TensorPool::trim() {
+    std::lock_guard<std::mutex> guard(mtx);
+    for (auto &item : freeLists)
+        for (auto ptr : item.second)
+            free(ptr);
+    freeLists.clear();
+    stats.cached = 0;
+}
+
+TensorPool::Stats TensorPool::getStats() {
+    std::lock_guard<std::mutex> guard(mtx);
+    return stats;
+}
+
+} // end of namespace tpm
@@ -0,0 +1,82 @@
+#include "trace.h"
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+
+namespace tpm {
+
+TraceEngine::TraceEngine()
+    : enabled(false), start(std::chrono::steady_clock::now()) {
+    auto env = getenv("PET_TRACE_FILE");
+    if (env != nullptr)
+        enable(env);
+}
+
+TraceEngine::~TraceEngine() {
+    if (enabled && !events.empty())
+        dump();
+}
+
+int TraceEngine::threadId() {
+    static std::atomic<int> cnt(0);
+    thread_local int tid = cnt++;
+    return tid;
+}
+
+void TraceEngine::addEvent(const std::string &name, int64_t ts, int64_t dur,
+                           Args &&args) {
+    int tid = threadId();
+    std::lock_guard<std::mutex> guard(mtx);
+    events.emplace_back(Event{name, tid, ts, dur, std::move(args)});
+}
+
+void TraceEngine::clear() {
+    std::lock_guard<std::mutex> guard(mtx);
+    events.clear();
+}
+
+static std::string jsonEscape(const std::string &str) {
+    std::string ret;
+    for (auto c : str) {
+        switch (c) {
+        case '"':
+            ret += "\\\"";
+            break;
+        case '\\':
+            ret += "\\\\";
+            break;
+        case '\n':
+            ret += "\\n";
+            break;
+        default:
+            ret += c;
+        }
+    }
+    return ret;
+}
+
+int TraceEngine::dump(const std::string &file) {
+    std::ofstream fout(file);
+    if (!fout) {
+        std::cout << "[ERROR] trace::dump: cannot open " << file << std::endl;
+        return 1;
+    }
+    std::lock_guard<std::mutex> guard(mtx);
+    fout << "{\"traceEvents\":[";
+    for (size_t i = 0, iEnd = events.size(); i < iEnd; ++i) {
+        auto &e = events[i];
+        fout << (i == 0 ? "\n" : ",\n") << "{\"name\":\"" << jsonEscape(e.name)
+             << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << e.tid
+             << ",\"ts\":" << e.ts << ",\"dur\":" << e.dur << ",\"args\":{";
+        for (size_t j = 0, jEnd = e.args.size(); j < jEnd; ++j) {
+            fout << (j == 0 ? "" : ",") << "\"" << jsonEscape(e.args[j].first)
+                 << "\":\"" << jsonEscape(e.args[j].second) << "\"";
+        }
+        fout << "}}";
+    }
+    fout << "\n],\"displayTimeUnit\":\"ms\"}\n";
+    return 0;
+}
+
+} // end of namespace tpm
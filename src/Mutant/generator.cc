@@ -1,5 +1,16 @@
 #include "generator.h"
 #include "cstdlib"
+#include "mutation_rules.h"
+#include "rule_stats.h"
+#include "strided_loop.h"
+#include "trace.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
 using namespace tpm;
 
 static int gcd(int a, int b) {
@@ -28,11 +39,26 @@ static int max(std::vector<int> &vec) {
 
 Generator::Generator(bool prune_reciprocity)
     : equal_threshold(0.7), num_valid_tensors(0), num_total_tensors(0),
-      max_depth(3), searchingGraph(new SubGraph()),
-      max_num_elements(1024 * 1024 * 1024), num_reserve_ops(0), group_size(0),
-      prune_reciprocity(prune_reciprocity), computingPos({}) {
+      max_depth(3), searchingGraph(new SubGraph()), num_reserve_ops(0),
+      group_size(0),
+      prune_reciprocity(prune_reciprocity), computingPos({}),
+      symbolic_only(false), num_workers(1),
+      split_depth(-1), next_branch(nullptr), claimed_branch(0),
+      num_branches(0), cur_branch(0) {
     enable_eq_opt = (getenv("PET_DISABLE_EQ_OPT") == nullptr);
+    sampling = SamplingPolicy::fromEnv();
+    auto verify = getenv("PET_VERIFY");
+    enable_box_verification = verify != nullptr && std::string(verify) == "box";
+    auto threads = getenv("PET_DFS_THREADS");
+    if (threads != nullptr)
+        setNumWorkers(atoi(threads));
     enable_non_eq_opt = (getenv("PET_DISABLE_NO_NEQ_OPT") == nullptr);
+    auto rulesFile = getenv("PET_MUTATION_RULES");
+    if (rulesFile != nullptr) {
+        rules = std::make_shared<MutationRules>();
+        if (rules->loadFile(rulesFile))
+            rules = nullptr;
+    }
     if (!enable_non_eq_opt)
         equal_threshold = 0.99;
     printf("Generator eq/non-eq opt status: %d/%d\n", enable_eq_opt,
@@ -40,12 +66,35 @@ Generator::Generator(bool prune_reciprocity)
     reserveTensors(10);
 }
 
+Generator::Generator(const Generator *master)
+    : equal_threshold(master->equal_threshold), num_valid_tensors(0),
+      num_total_tensors(0), max_depth(master->max_depth),
+      searchingGraph(new SubGraph()), num_reserve_ops(0), group_size(0),
+      prune_reciprocity(master->prune_reciprocity), computingPos({}),
+      sampling(master->sampling), symbolic_only(false),
+      enable_box_verification(master->enable_box_verification),
+      enable_eq_opt(master->enable_eq_opt),
+      enable_non_eq_opt(master->enable_non_eq_opt), rules(master->rules),
+      num_workers(1), split_depth(-1), next_branch(nullptr),
+      claimed_branch(0), num_branches(0), cur_branch(0) {
+    reserveTensors(10);
+}
+
+std::shared_ptr<Generator> Generator::makeSibling() const {
+    std::shared_ptr<Generator> ret(new Generator(this));
+    ret->num_workers = num_workers;
+    return ret;
+}
+
 void Generator::run(SubGraph *in_graph, std::vector<SubGraph *> &out_graphs,
                     int mdepth,
                     std::vector<std::shared_ptr<Operator>> candidate_ops,
                     float threshold) {
     if (!enable_non_eq_opt && !enable_eq_opt)
 	return;
+    TraceScope scope("Generator::run");
+    if (scope.isActive())
+        scope.arg("hash", in_graph->getHash()).arg("mdepth", mdepth);
     // TODO: remove and make sure all the ops in the input graph are in the
     // searching list
     // out_graphs.emplace_back(new SubGraph(in_graph->getOperators()));
@@ -56,29 +105,79 @@ void Generator::run(SubGraph *in_graph, std::vector<SubGraph *> &out_graphs,
     group_size = 0;
     auto mdenv = getenv("PET_MUTATION_DEPTH");
     auto graph_type = statGraph(in_graph);
-    if (prune_reciprocity && candidate_ops.empty()) {
+    run_type = getTypeName(graph_type);
+    run_family = getShapeFamily(in_graph);
+    mutantRules.clear();
+    // report the counters whichever way the run returns
+    counters = SearchCounters();
+    counters.runs = 1;
+    auto runStart = std::chrono::steady_clock::now();
+    size_t numOutGraphs = out_graphs.size();
+    struct RunReport {
+        std::function<void()> done;
+        ~RunReport() { done(); }
+    } report{[&]() {
+        counters.runTime =
+            std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - runStart)
+                .count();
+        // the cached mutants replace out_graphs
+        counters.mutants = out_graphs.size() >= numOutGraphs
+                               ? out_graphs.size() - numOutGraphs
+                               : out_graphs.size();
+        SearchStats::getInstance().add(
+            prune_reciprocity ? getTypeName(graph_type) : "Reciprocity",
+            counters);
+    }};
+    // cached for the built-in and the loaded candidates alike
+    if (prune_reciprocity && candidate_ops.empty() &&
+        graph_type == NormalConv) {
+        // equal convs of other graphs or models share the entry
+        auto it = mutationCache.find(in_graph->getCanonicalHash());
+        if (it != mutationCache.end()) {
+            auto &entry = it->second;
+            out_graphs.clear();
+            for (size_t i = 0, iEnd = entry.graphs.size(); i < iEnd; ++i) {
+                auto new_graph = loadCached(entry, i, in_graph);
+                markTransType(in_graph, new_graph);
+                if (!validDepth(new_graph)) {
+                    delete new_graph;
+                    continue;
+                }
+                out_graphs.emplace_back(new_graph);
+                mutantRules.emplace_back(entry.rules[i]);
+            }
+            return;
+        }
+    }
+    // graphs no rule matches get the built-in candidates
+    std::vector<const MutationRules::Rule *> matched;
+    if (prune_reciprocity && candidate_ops.empty() && rules != nullptr)
+        matched = rules->match(graph_type, in_graph);
+    if (!matched.empty()) {
+        if (!isCandidateTypeEnabled(graph_type))
+            return;
+        max_depth = 0;
+        for (auto rule : matched) {
+            for (auto &op : rule->ops)
+                candidate_ops.emplace_back(op(in_graph));
+            max_depth = std::max(max_depth, rule->depth);
+            if (rule->group != 0)
+                group_size = rule->group > 0 ? rule->group
+                                             : in_graph->getOperators().size();
+        }
+        if (mdenv != nullptr)
+            max_depth = mdepth > 0 ? mdepth : 3;
+    } else if (prune_reciprocity && candidate_ops.empty()) {
         switch (graph_type) {
         case Empty:
             return;
         case Conv1X1:
             addCandidateOpsForConv1x1(candidate_ops, in_graph);
             break;
-        case NormalConv: {
-            auto hash =
-                computeHashForSingleComputeOp(in_graph->getOperators()[0]);
-            if (mutationCache.find(hash) != mutationCache.end()) {
-                out_graphs.clear();
-                for (auto out : mutationCache[hash]) {
-                    auto new_graph = new SubGraph(out->getOperators());
-                    markTransType(in_graph, new_graph);
-                    if (validDepth(new_graph))
-                        out_graphs.emplace_back(new_graph);
-                }
-                return;
-            }
+        case NormalConv:
             addCandidateOpsForNormalConv(candidate_ops, in_graph);
             break;
-        }
         case NormalOddConv:
             addCandidateOpsForNormalOddConv(candidate_ops, in_graph);
             break;
@@ -113,15 +212,38 @@ void Generator::run(SubGraph *in_graph, std::vector<SubGraph *> &out_graphs,
 //     if (!enable_eq_opt && graph_type != DilatedConv)
 // 	max_depth = 3;
 
-    // Refresh candidate op list
+    // Refresh candidate op list, the ops of the last run are recycled
     for (auto &opv : all_ops)
-        for (auto op : opv)
-            if (op != nullptr)
-                delete op;
-    all_ops = std::vector<OpVec>(max_depth, OpVec());
+        opPool.release(opv);
+    all_ops.resize(max_depth);
     for (auto &opv : all_ops)
         for (auto op : candidate_ops)
-            opv.emplace_back(op->clone());
+            opv.emplace_back(opPool.acquire(op.get()));
+
+    symbolic_only = !candidate_ops.empty();
+    for (auto &op : candidate_ops)
+        if (!op->isTransposeOp())
+            symbolic_only = false;
+    refIndexMaps.clear();
+    for (auto output : in_graph->getOutputs()) {
+        IndexMap map;
+        if (!symbolic_only || !IndexMap::fromTensor(output, map)) {
+            symbolic_only = false;
+            break;
+        }
+        refIndexMaps.emplace_back(map);
+    }
+    target_dims.clear();
+    target_sizes.clear();
+    for (auto output : in_graph->getOutputs()) {
+        target_dims.emplace_back(output->getDims());
+        target_sizes.emplace(output->size());
+    }
+    reachable.clear();
+    size_preserving = !candidate_ops.empty();
+    for (auto &op : candidate_ops)
+        if (!op->isTransposeOp() && op->getType() != Operator::Identity)
+            size_preserving = false;
 
     // search reciprocities for pruning
     if (prune_reciprocity)
@@ -130,27 +252,33 @@ void Generator::run(SubGraph *in_graph, std::vector<SubGraph *> &out_graphs,
     for (auto input : in_graph->getInputs())
         input->dataRand();
     computingPos.clear();
+    // boundary sampling also picks the sides of the splitting points
+    if (sampling.mode == SamplingPolicy::Boundary) {
+        for (auto input : in_graph->getInputs())
+            input->initSplittingPoints();
+        for (auto op : in_graph->getOperators())
+            op->inferSplittingPoints();
+    }
     auto outputs = in_graph->getOutputs();
     for (size_t i = 0, iEnd = outputs.size(); i < iEnd; ++i) {
         computingPos.emplace_back(std::vector<std::pair<Dim, VType>>());
         auto &back = computingPos.back();
-        auto dm = outputs[i]->getDims();
-        srand(time(NULL));
-        for (int j = 0; j < 8; ++j) {
-            Dim randPos = {};
-            for (auto d : dm)
-                randPos.emplace_back(((rand() % 2) + 1) * d / 3);
-            back.emplace_back(std::make_pair(randPos, 0));
-        }
-        for (auto &pos : back) {
-            auto comp = in_graph->compute(pos.first, i);
-            if (!comp.first)
-                return;
-            pos.second = comp.second;
-        }
+        auto splits = outputs[i]->hasSplittingPoints()
+                          ? outputs[i]->getSplittingPoints()
+                          : nullptr;
+        auto points = sampling.samplePoints(outputs[i]->getDims(), i, splits);
+        for (auto &point : points)
+            back.emplace_back(std::make_pair(point, 0));
+        std::vector<VType> values;
+        ComputePlan plan(in_graph, i);
+        if (!plan.compute(points, values))
+            return;
+        for (size_t j = 0, jEnd = back.size(); j < jEnd; ++j)
+            back[j].second = values[j];
     }
 
     // set tensors
+    arena.resetPeak();
     auto num_input_tensors = in_graph->getInputs().size();
     auto new_num_total_tensors = num_input_tensors + max_depth * 2;
     // allocate new tensors if the backup tensors are not enough
@@ -160,12 +288,17 @@ void Generator::run(SubGraph *in_graph, std::vector<SubGraph *> &out_graphs,
         auto input = in_graph->getInputs()[i];
         auto tensor = searchingGraph->getTensors()[i];
         tensor->clone(input);
+        tensor->dataMalloc();
         tensor->setData(input->getDataPtr());
         tensor->initSplittingPoints();
     }
 
     if (enable_box_verification) {
-        // fully compute input graph
+        // fully compute input graph once, every mutant of this run is
+        // compared with these outputs
+        for (auto op : in_graph->getOperators())
+            for (auto output : op->getOutputs())
+                output->resetComputed();
         for (int i = 0; i < (int)in_graph->getOutputs().size(); ++i)
             in_graph->compute(in_graph->getOutputs()[i]->getDims(), i, true);
         // initialize splitting points for both the in_graph and searching graph
@@ -180,7 +313,34 @@ void Generator::run(SubGraph *in_graph, std::vector<SubGraph *> &out_graphs,
     num_valid_tensors = num_input_tensors;
 
     std::unordered_set<uint64_t> visited;
-    switch (graph_type) {
+    if (!matched.empty()) {
+        // every preprocessing step of the matched rules starts its own dfs,
+        // named after the rules taking it
+        std::vector<std::pair<Preprocess, std::string>> passes;
+        std::string names;
+        for (auto rule : matched) {
+            names += (names.empty() ? "" : "+") + rule->name;
+            for (auto pre : rule->preprocess) {
+                auto it = std::find_if(
+                    passes.begin(), passes.end(),
+                    [pre](const std::pair<Preprocess, std::string> &pass) {
+                        return pass.first == pre;
+                    });
+                if (it == passes.end())
+                    passes.emplace_back(pre, rule->name);
+                else
+                    it->second += "+" + rule->name;
+            }
+        }
+        if (passes.empty())
+            passes.emplace_back(nullptr, names);
+        if (graph_type == NormalConv)
+            runSplitGroupPass(in_graph, out_graphs);
+        for (auto &pass : passes)
+            runPass(pass.second, pass.first, in_graph, out_graphs, visited);
+        if (graph_type == NormalConv || graph_type == TransKernelConv)
+            addToCache(in_graph, out_graphs);
+    } else switch (graph_type) {
 
     case Conv1X1: {
         // addPreprocessForConv1x1(in_graph);
@@ -192,33 +352,25 @@ void Generator::run(SubGraph *in_graph, std::vector<SubGraph *> &out_graphs,
     }
 
     case NormalConv: {
-        splitGroupConv(in_graph, out_graphs);
+        runSplitGroupPass(in_graph, out_graphs);
         // break;
-        while (!oplist.empty())
-            popBackOp();
-        while (num_valid_tensors > in_graph->getInputs().size())
-            popBackTensor();
-	resetGraph(in_graph);
-        dfs(oplist.size(), in_graph, searchingGraph, out_graphs, visited);
+        runPass("Dfs", nullptr, in_graph, out_graphs, visited);
         addToCache(in_graph, out_graphs);
         break;
     }
 
     case TransKernelConv: {
-	resetGraph(in_graph);
-        addPreprocessForTransKernel(in_graph);
-        dfs(oplist.size(), in_graph, searchingGraph, out_graphs, visited);
+        runPass("TransKernel", &Generator::addPreprocessForTransKernel,
+                in_graph, out_graphs, visited);
         addToCache(in_graph, out_graphs);
         break;
     }
 
     case GroupConv: {
-	resetGraph(in_graph);
-        addPreprocessForGroupConvGCD(in_graph);
-        dfs(oplist.size(), in_graph, searchingGraph, out_graphs, visited);
-        resetGraph(in_graph);
-        addPreprocessForGroupConvMAX(in_graph);
-        dfs(oplist.size(), in_graph, searchingGraph, out_graphs, visited);
+        runPass("GCD", &Generator::addPreprocessForGroupConvGCD, in_graph,
+                out_graphs, visited);
+        runPass("MAX", &Generator::addPreprocessForGroupConvMAX, in_graph,
+                out_graphs, visited);
         resetGraph(in_graph);
         //addPreprocessForGroupConvOneInput(in_graph);
         //SubGraph *new_graph = new SubGraph(oplist);
@@ -241,32 +393,27 @@ void Generator::run(SubGraph *in_graph, std::vector<SubGraph *> &out_graphs,
     }
 
     case TransposeGroupConv: {
-	resetGraph(in_graph);
-        addPreprocessForTransposeGroupConvRS(in_graph);
-        dfs(oplist.size(), in_graph, searchingGraph, out_graphs, visited);
-        resetGraph(in_graph);
-        addPreprocessForTransposeGroupConvSR(in_graph);
-        dfs(oplist.size(), in_graph, searchingGraph, out_graphs, visited);
+        runPass("RS", &Generator::addPreprocessForTransposeGroupConvRS,
+                in_graph, out_graphs, visited);
+        runPass("SR", &Generator::addPreprocessForTransposeGroupConvSR,
+                in_graph, out_graphs, visited);
         break;
     }
 
     case NormalOddConv: {
-	resetGraph(in_graph);
-        addPreprocessForPadSlice(in_graph);
-        dfs(oplist.size(), in_graph, searchingGraph, out_graphs, visited);
+        runPass("PadSlice", &Generator::addPreprocessForPadSlice, in_graph,
+                out_graphs, visited);
         break;
     }
 
     case BatchMatmul: {
-	resetGraph(in_graph);
-        addPreprocessForBatchMatmul(in_graph);
-        dfs(oplist.size(), in_graph, searchingGraph, out_graphs, visited);
+        runPass("BatchMatmul", &Generator::addPreprocessForBatchMatmul,
+                in_graph, out_graphs, visited);
         break;
     }
 
     default: {
-	resetGraph(in_graph);
-        dfs(oplist.size(), in_graph, searchingGraph, out_graphs, visited);
+        runPass("Dfs", nullptr, in_graph, out_graphs, visited);
         break;
     }
     }
@@ -276,6 +423,7 @@ void Generator::run(SubGraph *in_graph, std::vector<SubGraph *> &out_graphs,
         popBackTensor();
     num_reserve_ops = 0;
     group_size = -1;
+    scope.arg("arena_peak", arena.getPeak());
 }
 
 void printTensor(tpm::Tensor *tensor) {
@@ -292,6 +440,12 @@ void printTensor(tpm::Tensor *tensor) {
 void Generator::dfs(int depth, SubGraph *in_graph, SubGraph *cur_graph,
                     std::vector<SubGraph *> &out_graphs,
                     std::unordered_set<uint64_t> &visited) {
+    if (!claimBranch(depth))
+        return;
+    counters.nodes++;
+    // deeper levels are too many to trace
+    TraceScope scope("Generator::dfs", depth <= 1);
+    scope.arg("depth", depth);
     // Connect the graph
     if (!cur_graph->resetOps(oplist, num_valid_tensors)) {
         return;
@@ -299,12 +453,15 @@ void Generator::dfs(int depth, SubGraph *in_graph, SubGraph *cur_graph,
 
     // Prune if having searched an identical graph
     if (!visited.insert(cur_graph->getHash()).second) {
+        counters.prunedVisited++;
         return;
     }
 
     // prune reciprocities
-    if (prune_reciprocity && reciprocity->is_tail_reciprocity(oplist))
+    if (prune_reciprocity && reciprocity->is_tail_reciprocity(oplist)) {
+        counters.prunedReciprocity++;
         return;
+    }
 
     // If full_computing is true, there is no conv/gemm ops and all ops are
     // computed instead of sampling verification
@@ -321,7 +478,14 @@ void Generator::dfs(int depth, SubGraph *in_graph, SubGraph *cur_graph,
         // Only non-computing op will not be a mutant
         // TODO: when dim compute for transpose is ready
         if (!full_computing || !prune_reciprocity) {
-            if (is_a_mutant(cur_graph, in_graph, full_computing)) {
+            auto verifyStart = std::chrono::steady_clock::now();
+            bool isMutant = is_a_mutant(cur_graph, in_graph, full_computing);
+            counters.verifications++;
+            counters.verifyTime +=
+                std::chrono::duration_cast<std::chrono::microseconds>(
+                    std::chrono::steady_clock::now() - verifyStart)
+                    .count();
+            if (isMutant) {
                 // // debug
                 // for (auto candidate : candidates) {
                 //     candidate->print();
@@ -343,8 +507,16 @@ void Generator::dfs(int depth, SubGraph *in_graph, SubGraph *cur_graph,
                 }
                 if (prune_reciprocity)
                     markTransType(in_graph, new_graph);
-                if (validDepth(new_graph))
+                if (validDepth(new_graph)) {
                     out_graphs.emplace_back(new_graph);
+                    if (next_branch != nullptr)
+                        found_branches.emplace_back(cur_branch);
+                } else {
+                    counters.prunedDepth++;
+                    // the ops of a dropped copy go back to the pool
+                    opPool.release(new_graph->getOperators());
+                    delete new_graph;
+                }
                 return;
             }
         }
@@ -362,6 +534,10 @@ void Generator::dfs(int depth, SubGraph *in_graph, SubGraph *cur_graph,
             for (size_t i = 0; i < num_valid_tensors; i++) {
 		if (i > 10) continue;
                 Tensor *x = cur_graph->getTensors()[i];
+                if (!shapeReachable(op, x, depth)) {
+                    counters.prunedShape++;
+                    continue;
+                }
                 TensorVec outs;
                 auto outsNum = split->getSizes().size();
                 for (size_t j = 0; j < outsNum; ++j)
@@ -559,6 +735,10 @@ void Generator::dfs(int depth, SubGraph *in_graph, SubGraph *cur_graph,
             for (size_t i = group_size * 3; i < num_valid_tensors; i++) {
 		if (i > 10) break;
                 Tensor *x = cur_graph->getTensors()[i];
+                if (!shapeReachable(op, x, depth)) {
+                    counters.prunedShape++;
+                    continue;
+                }
                 Tensor *output = newTensor();
                 // TODO: make sure there is no bug
                 // Sub-graph with only transpose op donot need to be computed
@@ -570,7 +750,7 @@ void Generator::dfs(int depth, SubGraph *in_graph, SubGraph *cur_graph,
                 //     (!local_full_computing && !op->computeShape(x, output)))
                 //     { popBackTensor(op); continue;
                 // }
-                if (prune_reciprocity) {
+                if (prune_reciprocity || symbolic_only) {
                     if (!op->computeShape({x}, {output})) {
                         popBackTensor(op);
                         continue;
@@ -604,6 +784,8 @@ void Generator::dfs(int depth, SubGraph *in_graph, SubGraph *cur_graph,
 
 bool Generator::is_a_mutant(const SubGraph *mutant_graph,
                             const SubGraph *input_graph, bool full_computing) {
+    TraceScope scope("Generator::is_a_mutant");
+    scope.arg("full", full_computing);
     size_t mouts = 0;
     for (auto output : mutant_graph->getOutputs()) {
         if (!output->isNotCounted())
@@ -617,12 +799,17 @@ bool Generator::is_a_mutant(const SubGraph *mutant_graph,
          ++midx) {
         if (mutant_graph->getOutputs()[midx]->getType() == Tensor::NotCounted)
             continue;
-        if (full_computing) {
+        if (full_computing && symbolic_only) {
+            if (!symbolic_equal(mutant_graph, midx, input_graph, iidx))
+                return false;
+        } else if (full_computing) {
             if (!approx_equal(mutant_graph->getOutputs()[midx],
                               input_graph->getOutputs()[iidx]))
                 return false;
-        } else if (!enable_box_verification) {
-            // sampling points
+        } else if (!enable_box_verification ||
+                   !mutant_graph->getOutputs()[midx]->hasSplittingPoints() ||
+                   !input_graph->getOutputs()[iidx]->hasSplittingPoints()) {
+            // sampling points, also for the graphs whose boxes are unknown
             if (!approx_equal(mutant_graph, midx, input_graph, iidx))
                 return false;
         } else {
@@ -695,6 +882,25 @@ bool Generator::is_a_mutant(const SubGraph *mutant_graph,
     return true;
 }
 
+// a copy of the ops and op outputs of graph that reads the inputs of graph in
+// place, output copyId of the copy is output id of graph
+static SubGraph *privateCopy(const SubGraph *graph, size_t id,
+                             size_t &copyId) {
+    auto ret = new SubGraph(graph->getOperators());
+    for (auto input : ret->getInputs())
+        for (auto src : graph->getInputs())
+            if (src->getHash() == input->getHash())
+                input->setView(src, Dim(src->getDims().size(), 0));
+    auto &outputs = ret->getOutputs();
+    auto hash = graph->getOutputs()[id]->getHash();
+    copyId = std::find_if(outputs.begin(), outputs.end(),
+                          [hash](const Tensor *t) {
+                              return t->getHash() == hash;
+                          }) -
+             outputs.begin();
+    return ret;
+}
+
 bool Generator::approx_equal_splitting_points(const SubGraph *mutant_graph,
                                               size_t midx,
                                               const SubGraph *input_graph,
@@ -806,41 +1012,69 @@ bool Generator::approx_equal_splitting_points(const SubGraph *mutant_graph,
     // }
     // printf("]\n");
 
-    // verify the data on the samping points
-    for (auto &pos_boxId : verified_points) {
-        auto comp = mutant_graph->compute(pos_boxId.first, midx);
-        if (!comp.first) {
-            // printf("mutant graph cannot compute: ");
-            // for (auto v : pos_boxId.first)
-            //     printf(" %d", v);
-            // puts("");
-            return false;
+    // Point runners write into the op outputs of the mutant, so every thread
+    // but the first computes the points on its own copy of the mutant.
+    for (auto op : mutant_graph->getOperators())
+        for (auto t : op->getOutputs())
+            t->dataMalloc();
+    // 1: equal, 0: not equal, -1: cannot compute
+    std::vector<int> results(verified_points.size(), 1);
+    auto verify = [&](size_t begin, size_t end, bool repOnly,
+                      const std::vector<int> &skip) {
+        std::atomic<bool> failed(false);
+#pragma omp parallel if (end - begin > 1)
+        {
+            std::unique_ptr<SubGraph> copy;
+            size_t outputId = midx;
+            if (omp_get_thread_num() > 0)
+                copy.reset(privateCopy(mutant_graph, midx, outputId));
+            ComputePlan plan(copy ? copy.get() : mutant_graph, outputId);
+#pragma omp for schedule(dynamic, 16)
+            for (size_t i = begin; i < end; ++i) {
+                auto &pos_boxId = verified_points[i];
+                bool isRep = i == 0 || verified_points[i - 1].second !=
+                                           pos_boxId.second;
+                if (failed || isRep != repOnly || skip[pos_boxId.second])
+                    continue;
+                VType value;
+                if (!plan.compute(pos_boxId.first, value)) {
+                    results[i] = -1;
+                    failed = true;
+                } else
+                    results[i] = ans_tensor->getData(pos_boxId.first) == value;
+            }
         }
-        if (input_graph->getOutputs()[iidx]->getData(pos_boxId.first) !=
-            comp.second)
-            box_error_cnt[pos_boxId.second]++;
-
-        // printf("Verification points: ");
-        // for (auto p : pos_boxId.first)
-        //     printf("%d,", p);
-        // printf((comp.second ==
-        //         input_graph->getOutputs()[output_idx]->getData(pos_boxId.first))
-        //            ? ": %d %d\n"
-        //            : ": %d %d XXX\n",
-        //        comp.second,
-        //        input_graph->getOutputs()[output_idx]->getData(pos_boxId.first));
-    }
+        return !failed.load();
+    };
 
-    // calculate weighted accuracy by num of elements in a box
-    int equal = 0, total = 1;
+    // one representative point per box first, a box whose representative
+    // differs needs no more points
+    int total = 1;
     for (auto len : dims)
         total *= len;
+    std::vector<int> noSkip(box_cnt, 0);
+    if (!verify(0, 1, true, noSkip) ||
+        !verify(1, verified_points.size(), true, noSkip))
+        return false;
+    int error = 0;
+    for (size_t i = 0; i < verified_points.size(); ++i)
+        if (results[i] == 0 && !box_error_cnt[verified_points[i].second]++)
+            error += box_element_cnt[verified_points[i].second];
+    if (float(total - error) / total <= equal_threshold)
+        return false;
+    // then the neighbours of the representatives in the remaining boxes
+    if (!verify(0, verified_points.size(), false, box_error_cnt))
+        return false;
+    for (size_t i = 0; i < verified_points.size(); ++i)
+        if (results[i] == 0)
+            box_error_cnt[verified_points[i].second]++;
+
+    // calculate weighted accuracy by num of elements in a box
+    int equal = 0;
     for (int i = 0; i < box_cnt; ++i) {
         if (box_error_cnt[i] == 0)
             equal += box_element_cnt[i];
     }
-    // debug
-    // printf("accuracy %lf\n", double(equal) / total);
     return (float(equal) / total > equal_threshold);
 }
 
@@ -849,14 +1083,17 @@ bool Generator::approx_equal(const SubGraph *mutant_graph, size_t midx,
     if (mutant_graph->getOutputs()[midx]->getDims() !=
         input_graph->getOutputs()[iidx]->getDims())
         return false;
+    ComputePlan plan(mutant_graph, midx);
     int equal = 0, total = 0;
     for (auto &pos : computingPos[iidx]) {
-        auto comp = mutant_graph->compute(pos.first, midx);
-        if (!comp.first)
+        VType value;
+        if (!plan.compute(pos.first, value))
             return false;
-        if (comp.second == pos.second)
+        if (value == pos.second)
             equal++;
         total++;
+        if (sampling.shouldReject(total - equal, equal_threshold))
+            return false;
     }
     // if (equal > 0) {
     //     std::cout << std::endl;
@@ -871,20 +1108,17 @@ bool Generator::approx_equal(Tensor *a, Tensor *b) {
     // std::cout << "approx_equal" << std::endl;
     if (a->getDims() != b->getDims())
         return false;
-    size_t equal = 0, total = 0;
-    VType *a_ptr = a->getDataPtr();
-    VType *b_ptr = b->getDataPtr();
-    // std::cout << "Comparing tensor " << (a->getGuid()) << " with
-    // tensor "
-    // << (b->getGuid()) << std::endl; std::cout << "a_ptr: " << a_ptr
-    // << ", b_ptr: " << b_ptr << std::endl;
-    for (size_t i = 0; i < a->size(); i++) {
-        // if (i % 32 == 0)
-        //     std::cout << a_ptr[i] << "." << b_ptr[i] << " ";
-        if (a_ptr[i] == b_ptr[i])
-            equal++;
-        total++;
-    }
+    size_t equal = 0, total = a->size();
+    // b is an output of the input graph shared by all the workers, views are
+    // read in place
+    auto a_ptr = a->getReadPtr(), b_ptr = b->getReadPtr();
+    StridedLoop loop(a->getDims(), {a->getStrides(), b->getStrides()});
+    auto as = loop.getInnerStride(0), bs = loop.getInnerStride(1);
+    loop.forEach([&](const size_t *offsets, size_t n) {
+        for (size_t j = 0; j < n; ++j)
+            if (a_ptr[offsets[0] + j * as] == b_ptr[offsets[1] + j * bs])
+                equal++;
+    });
     // std::cout << std::endl;
     // std::cout << "approx_equal: " << equal << "/" << total <<
     // std::endl;
@@ -893,6 +1127,21 @@ bool Generator::approx_equal(Tensor *a, Tensor *b) {
     return false;
 }
 
+bool Generator::symbolic_equal(const SubGraph *mutant_graph, size_t midx,
+                               const SubGraph *input_graph, size_t iidx) {
+    auto output = mutant_graph->getOutputs()[midx];
+    if (output->getDims() != refIndexMaps[iidx].getDims())
+        return false;
+    IndexMap map;
+    if (IndexMap::fromTensor(output, map))
+        return map == refIndexMaps[iidx];
+    // the dfs only computed the shapes
+    for (auto op : mutant_graph->getOperators())
+        if (op->compute() == nullptr)
+            return false;
+    return approx_equal(output, input_graph->getOutputs()[iidx]);
+}
+
 bool Generator::pushBackOp(Operator *op) {
     oplist.emplace_back(op);
     if (enable_box_verification)
@@ -928,9 +1177,9 @@ bool Generator::popBackTensor(Operator *op) {
 void Generator::reserveTensors(size_t size) {
     if (num_total_tensors >= size)
         return;
-    Dim max_dim = {(int)max_num_elements};
+    // data is taken from the arena once the shape is known
     for (size_t i = num_total_tensors; i < size; ++i)
-        searchingGraph->tensor(max_dim)->dataMalloc();
+        searchingGraph->tensor({1})->setAllocator(&arena);
     num_total_tensors = size;
 }
 
@@ -961,11 +1210,107 @@ bool Generator::have_same_op(Operator *new_op) {
             new_op->getInputs()[1]->getHash() !=
                 exist_op->getInputs()[1]->getHash())
             continue;
+        counters.prunedSameOp++;
         return true;
     }
     return false;
 }
 
+bool Generator::shapeReachable(Operator *op, const Tensor *input, int depth) {
+    if (input->isNotCounted())
+        return true;
+    // ops that can still follow op, the output of the last op is an output
+    // of the mutant
+    int steps = max_depth - (int)std::max((size_t)depth, oplist.size()) - 1;
+    if (steps <= 0 && oplist.size() + 1 <= num_reserve_ops)
+        return false;
+    // no candidate changes the number of elements of a tensor
+    if (size_preserving && target_sizes.count(input->size()) == 0)
+        return false;
+    Dim dims;
+    if (op->getType() == Operator::Split) {
+        auto split = (SplitOp *)op;
+        auto &inDims = input->getDims();
+        if (split->getDim() < 0 || split->getDim() >= (int)inDims.size())
+            return false;
+        int parts = 0;
+        for (auto size : split->getSizes())
+            parts += size;
+        return parts == 0 || inDims[split->getDim()] % parts == 0;
+    }
+    if (op->isTransposeOp()) {
+        auto trans = (TransposeOp *)op;
+        if (trans->getBefore().size() != input->getDims().size())
+            return false;
+        dims = trans->inferShape(input->getDims());
+        if (dims.empty())
+            return false;
+    } else if (op->getType() == Operator::Identity)
+        dims = input->getDims();
+    else
+        return true;
+    // with only transposes and identities every tensor is the source of a
+    // chain of them ending at an output, otherwise only the last op is known
+    if (steps > 0 && !size_preserving)
+        return true;
+    return reachesTarget(dims, steps);
+}
+
+bool Generator::reachesTarget(const Dim &dims, int steps) {
+    if (std::find(target_dims.begin(), target_dims.end(), dims) !=
+        target_dims.end())
+        return true;
+    if (steps <= 0 || all_ops.empty())
+        return false;
+    auto key = std::make_pair(dims, steps);
+    auto it = reachable.find(key);
+    if (it != reachable.end())
+        return it->second;
+    bool ret = false;
+    // the candidates are the same at every depth
+    for (auto op : all_ops[0]) {
+        if (!op->isTransposeOp())
+            continue;
+        auto trans = (TransposeOp *)op;
+        if (trans->getBefore().size() != dims.size())
+            continue;
+        auto next = trans->inferShape(dims);
+        if (!next.empty() && reachesTarget(next, steps - 1)) {
+            ret = true;
+            break;
+        }
+    }
+    reachable.emplace(key, ret);
+    return ret;
+}
+
+const char *Generator::getTypeName(SGType type) {
+    switch (type) {
+    case Empty:
+        return "Empty";
+    case NormalConv:
+        return "NormalConv";
+    case NormalOddConv:
+        return "NormalOddConv";
+    case DilatedConv:
+        return "DilatedConv";
+    case TransKernelConv:
+        return "TransKernelConv";
+    case GroupConv:
+        return "GroupConv";
+    case TransposeGroupConv:
+        return "TransposeGroupConv";
+    case Conv1X1:
+        return "Conv1X1";
+    case NormalMatmul:
+        return "NormalMatmul";
+    case BatchMatmul:
+        return "BatchMatmul";
+    default:
+        return "Others";
+    }
+}
+
 Generator::SGType Generator::statGraph(SubGraph *sg) {
     auto ops = sg->getOperators();
     switch (ops.size()) {
@@ -1906,13 +2251,119 @@ uint64_t Generator::computeHashForSingleConv(Operator *op) {
 
 void Generator::addToCache(SubGraph *sg, std::vector<SubGraph *> &out_graphs) {
     assert(sg->getOperators().size() == 1);
-    auto hash = computeHashForSingleComputeOp(sg->getOperators()[0]);
+    auto hash = sg->getCanonicalHash();
     if (mutationCache.find(hash) != mutationCache.end())
         return;
-    auto cache = std::vector<std::shared_ptr<SubGraph>>{};
-    for (auto out : out_graphs)
-        cache.emplace_back(new SubGraph(out->getOperators()));
-    mutationCache.emplace(hash, std::vector<std::shared_ptr<SubGraph>>{});
+    CachedMutants entry;
+    for (auto t : sg->getInputs())
+        entry.inputs.emplace_back(t->getHash());
+    for (auto t : sg->getOutputs())
+        entry.outputs.emplace_back(t->getHash());
+    // the mutants of this run are the last ones, one per rule key
+    assert(mutantRules.size() <= out_graphs.size());
+    for (size_t i = out_graphs.size() - mutantRules.size(), j = 0;
+         i < out_graphs.size(); ++i, ++j) {
+        entry.graphs.emplace_back(new SubGraph(out_graphs[i]->getOperators()));
+        entry.rules.emplace_back(mutantRules[j]);
+    }
+    mutationCache.emplace(hash, entry);
+}
+
+SubGraph *Generator::loadCached(const CachedMutants &entry, size_t idx,
+                                SubGraph *in_graph) {
+    auto ret = new SubGraph(entry.graphs[idx]->getOperators());
+    // the tensors of the cached graph are bound by position to those of
+    // in_graph, the others are new
+    std::unordered_map<uint64_t, Tensor *> bind;
+    for (size_t i = 0, iEnd = entry.inputs.size(); i < iEnd; ++i)
+        bind[entry.inputs[i]] = in_graph->getInputs()[i];
+    for (size_t i = 0, iEnd = entry.outputs.size(); i < iEnd; ++i)
+        bind[entry.outputs[i]] = in_graph->getOutputs()[i];
+    for (auto t : ret->getTensors()) {
+        auto it = bind.find(t->getHash());
+        if (it != bind.end())
+            t->clone(it->second);
+        else
+            t->refresh();
+    }
+    return ret;
+}
+
+void Generator::runSplitGroupPass(SubGraph *in_graph,
+                                  std::vector<SubGraph *> &out_graphs) {
+    auto key = getRuleKey("SplitGroup");
+    if (prune_reciprocity && RuleStats::getInstance().shouldSkip(key))
+        counters.skippedPasses++;
+    else {
+        size_t num = out_graphs.size();
+        splitGroupConv(in_graph, out_graphs);
+        if (prune_reciprocity)
+            RuleStats::getInstance().recordRun(key, out_graphs.size() - num);
+        mutantRules.resize(mutantRules.size() + out_graphs.size() - num, key);
+    }
+    while (!oplist.empty())
+        popBackOp();
+    while (num_valid_tensors > in_graph->getInputs().size())
+        popBackTensor();
+}
+
+// the EQOPT/NEQOPT gates of the addCandidateOpsFor* methods
+bool Generator::isCandidateTypeEnabled(SGType type) const {
+    switch (type) {
+    case NormalOddConv:
+    case DilatedConv:
+        return enable_non_eq_opt;
+    case NormalMatmul:
+        return enable_eq_opt;
+    default:
+        return true;
+    }
+}
+
+void Generator::runPass(const std::string &pass, Preprocess pre,
+                        SubGraph *in_graph, std::vector<SubGraph *> &out_graphs,
+                        std::unordered_set<uint64_t> &visited) {
+    // only the mutation search keeps the history of its passes
+    auto key = getRuleKey(pass);
+    if (prune_reciprocity && RuleStats::getInstance().shouldSkip(key)) {
+        counters.skippedPasses++;
+        return;
+    }
+    size_t num = out_graphs.size();
+    resetGraph(in_graph);
+    if (pre != nullptr)
+        (this->*pre)(in_graph);
+    runDfs(in_graph, out_graphs, visited);
+    if (prune_reciprocity)
+        RuleStats::getInstance().recordRun(key, out_graphs.size() - num);
+    mutantRules.resize(mutantRules.size() + out_graphs.size() - num, key);
+}
+
+std::string Generator::getRuleKey(const std::string &pass) const {
+    return run_type + "." + pass + "@" + run_family;
+}
+
+std::string Generator::getShapeFamily(SubGraph *sg) {
+    if (sg->getOperators().empty())
+        return "none";
+    auto op = sg->getOperators()[0];
+    std::ostringstream os;
+    if (op->getType() == Operator::Conv) {
+        auto conv = (ConvOp *)op;
+        auto &input = op->getInputs()[0]->getDims();
+        auto &weight = op->getInputs()[1]->getDims();
+        os << weight[2] << "x" << weight[3];
+        if (conv->getSh() > 1 || conv->getSw() > 1)
+            os << "s";
+        if (conv->getDh() > 1 || conv->getDw() > 1)
+            os << "d";
+        if (input[1] != weight[1])
+            os << "g";
+    } else if (op->getType() == Operator::Matmul)
+        os << (op->getInputs()[0]->getDims()[0] > 1 ? "bmm" : "mm");
+    else
+        os << "other";
+    return os.str();
 }
 
 void Generator::resetGraph(const SubGraph *in_graph) {
@@ -1922,6 +2373,157 @@ void Generator::resetGraph(const SubGraph *in_graph) {
         popBackTensor();
 }
 
+void Generator::runDfs(SubGraph *in_graph, std::vector<SubGraph *> &out_graphs,
+                       std::unordered_set<uint64_t> &visited) {
+    if (num_workers <= 1 || (int)oplist.size() >= max_depth) {
+        dfs(oplist.size(), in_graph, searchingGraph, out_graphs, visited);
+        return;
+    }
+    while ((int)workers.size() < num_workers)
+        workers.emplace_back(new Generator(this));
+    // Every worker walks the same branches in the same order, and only
+    // searches below the ones it claims from the shared counter, so an idle
+    // worker always picks up the next unsearched branch.
+    std::atomic<size_t> next(0);
+    std::vector<std::vector<SubGraph *>> found(num_workers);
+    std::vector<std::unordered_set<uint64_t>> workerVisited(num_workers,
+                                                            visited);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < num_workers; ++i) {
+        auto worker = workers[i].get();
+        threads.emplace_back([this, worker, in_graph, i, &next, &found,
+                              &workerVisited]() {
+            worker->syncWith(*this);
+            worker->next_branch = &next;
+            worker->claimed_branch = next++;
+            worker->dfs(worker->oplist.size(), in_graph,
+                        worker->searchingGraph, found[i], workerVisited[i]);
+        });
+    }
+    for (auto &t : threads)
+        t.join();
+
+    // merge in branch order and drop mutants found by more than one worker
+    std::vector<std::pair<size_t, SubGraph *>> merged;
+    for (int i = 0; i < num_workers; ++i) {
+        auto worker = workers[i].get();
+        for (size_t j = 0, jEnd = found[i].size(); j < jEnd; ++j)
+            merged.emplace_back(worker->found_branches[j], found[i][j]);
+        visited.insert(workerVisited[i].begin(), workerVisited[i].end());
+        counters.add(worker->counters);
+        worker->resetWorker();
+    }
+    std::stable_sort(merged.begin(), merged.end(),
+                     [](const std::pair<size_t, SubGraph *> &a,
+                        const std::pair<size_t, SubGraph *> &b) {
+                         return a.first < b.first;
+                     });
+    std::unordered_set<uint64_t> seen;
+    for (auto &item : merged) {
+        if (seen.insert(item.second->getHash()).second)
+            out_graphs.emplace_back(item.second);
+        else
+            delete item.second;
+    }
+}
+
+void Generator::syncWith(Generator &master) {
+    equal_threshold = master.equal_threshold;
+    max_depth = master.max_depth;
+    num_reserve_ops = master.num_reserve_ops;
+    group_size = master.group_size;
+    prune_reciprocity = master.prune_reciprocity;
+    reciprocity = master.reciprocity;
+    computingPos = master.computingPos;
+    sampling = master.sampling;
+    counters = SearchCounters();
+    symbolic_only = master.symbolic_only;
+    refIndexMaps = master.refIndexMaps;
+    target_dims = master.target_dims;
+    target_sizes = master.target_sizes;
+    size_preserving = master.size_preserving;
+    reachable.clear();
+    enable_box_verification = master.enable_box_verification;
+    enable_eq_opt = master.enable_eq_opt;
+    enable_non_eq_opt = master.enable_non_eq_opt;
+
+    for (auto &opv : all_ops)
+        opPool.release(opv);
+    all_ops.resize(master.all_ops.size());
+    for (size_t i = 0; i < all_ops.size(); ++i)
+        for (auto op : master.all_ops[i])
+            all_ops[i].emplace_back(opPool.acquire(op));
+
+    // tensors produced by the preprocessed ops get their splitting points
+    // from the ops
+    std::unordered_set<Tensor *> produced;
+    for (auto op : master.oplist)
+        for (auto t : op->getOutputs())
+            produced.insert(t);
+    std::unordered_map<Tensor *, Tensor *> tensorMap;
+    reserveTensors(master.num_valid_tensors);
+    for (size_t i = 0; i < master.num_valid_tensors; ++i) {
+        auto src = master.searchingGraph->getTensors()[i];
+        auto tensor = newTensor();
+        tensor->clone(src);
+        // views of master read the same base, materializing them here
+        // would write master from every worker
+        if (src->isComputed() && src->isView()) {
+            tensor->setView(src, Dim(src->getDims().size(), 0));
+            tensor->setComputed();
+        } else if (src->isComputed()) {
+            tensor->dataMalloc();
+            tensor->setData(src->getDataPtr());
+        }
+        if (enable_box_verification && produced.count(src) == 0)
+            tensor->initSplittingPoints();
+        tensorMap[src] = tensor;
+    }
+
+    // tensors outside the searching graph are shared with master
+    auto mapTensors = [&tensorMap](const TensorVec &tensors) {
+        TensorVec ret;
+        for (auto t : tensors) {
+            auto it = tensorMap.find(t);
+            ret.emplace_back(it == tensorMap.end() ? t : it->second);
+        }
+        return ret;
+    };
+    for (auto op : master.oplist) {
+        auto newOp = opPool.acquire(op);
+        newOp->setInputs(mapTensors(op->getInputs()));
+        newOp->setOutputs(mapTensors(op->getOutputs()));
+        synced_ops.emplace_back(newOp);
+        pushBackOp(newOp);
+    }
+
+    split_depth = oplist.size() + 1;
+    num_branches = 0;
+    cur_branch = 0;
+    found_branches.clear();
+}
+
+void Generator::resetWorker() {
+    while (!oplist.empty())
+        popBackOp();
+    while (num_valid_tensors > 0)
+        popBackTensor();
+    opPool.release(synced_ops);
+    next_branch = nullptr;
+    split_depth = -1;
+    found_branches.clear();
+}
+
+bool Generator::claimBranch(int depth) {
+    if (next_branch == nullptr || depth != split_depth)
+        return true;
+    cur_branch = num_branches++;
+    if (cur_branch != claimed_branch)
+        return false;
+    claimed_branch = (*next_branch)++;
+    return true;
+}
+
 void Generator::markTransType(SubGraph *inputGraph, SubGraph *outputGraph) {
     auto &ops = outputGraph->getOperators();
     if (ops.size() != 3) {
@@ -1999,8 +2601,120 @@ bool Generator::validDepth(SubGraph *sg) {
     return true;
 }
 
+typedef std::map<uint64_t, std::vector<std::vector<uint64_t>>>
+    ReciprocityTable;
+
+static std::mutex reciprocityMutex;
+
+static ReciprocityTable &reciprocityTable() {
+    static ReciprocityTable table;
+    return table;
+}
+
+static int loadReciprocityTable(const std::string &file) {
+    std::ifstream fin(file);
+    std::string tag;
+    int version;
+    if (!(fin >> tag >> version) || tag != "PET_RECIPROCITY" || version != 1) {
+        std::cout << "[ERROR] generator::loadReciprocityTable: invalid file "
+                  << file << std::endl;
+        return 1;
+    }
+    ReciprocityTable loaded;
+    uint64_t key;
+    size_t n, len;
+    while (fin >> key >> n) {
+        auto &chains = loaded[key];
+        for (size_t i = 0; i < n; ++i) {
+            if (!(fin >> len))
+                return 1;
+            chains.emplace_back(len);
+            for (auto &h : chains.back())
+                if (!(fin >> h))
+                    return 1;
+        }
+    }
+    if (!fin.eof())
+        return 1;
+    reciprocityTable().insert(loaded.begin(), loaded.end());
+    return 0;
+}
+
+// The table is written to a temporary file and renamed, like the search
+// engine checkpoint
+static int saveReciprocityTable(const std::string &file) {
+    std::string tmpFile = file + ".tmp";
+    std::ofstream fout(tmpFile);
+    fout << "PET_RECIPROCITY 1\n";
+    for (auto &kv : reciprocityTable()) {
+        fout << kv.first << " " << kv.second.size() << "\n";
+        for (auto &chain : kv.second) {
+            fout << chain.size();
+            for (auto h : chain)
+                fout << " " << h;
+            fout << "\n";
+        }
+    }
+    fout.close();
+    if (!fout || std::rename(tmpFile.c_str(), file.c_str()) != 0) {
+        std::cout << "[ERROR] generator::saveReciprocityTable: cannot write "
+                  << file << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
 Reciprocity::Reciprocity(const std::vector<std::shared_ptr<Operator>> &ops) {
+    // only transposes are searched, so they alone decide the chains
+    std::vector<uint64_t> hashes;
+    for (auto &op : ops)
+        if (op->getType() == Operator::OpType::Transpose)
+            hashes.emplace_back(op->getHash());
+    std::sort(hashes.begin(), hashes.end());
+    hashes.erase(std::unique(hashes.begin(), hashes.end()), hashes.end());
+    uint64_t key = hashCombine(MAX_RECIPROCITY_DETECT_DEPTH, hashes.size());
+    for (auto h : hashes)
+        key = hashCombine(key, h);
+
+    std::lock_guard<std::mutex> guard(reciprocityMutex);
+    static bool loaded = false;
+    auto file = getenv("PET_RECIPROCITY_FILE");
+    if (!loaded && file != nullptr) {
+        std::ifstream fin(file);
+        if (fin)
+            loadReciprocityTable(file);
+    }
+    loaded = true;
+    auto &table = reciprocityTable();
+    auto it = table.find(key);
+    if (it != table.end()) {
+        reciprocal_op_chains = it->second;
+        return;
+    }
     search_reciprocity(ops);
+    table.emplace(key, reciprocal_op_chains);
+    if (file != nullptr)
+        saveReciprocityTable(file);
+}
+
+int Reciprocity::loadTable(const std::string &file) {
+    std::lock_guard<std::mutex> guard(reciprocityMutex);
+    return loadReciprocityTable(file);
+}
+
+int Reciprocity::saveTable(const std::string &file) {
+    std::lock_guard<std::mutex> guard(reciprocityMutex);
+    return saveReciprocityTable(file);
+}
+
+void Reciprocity::clearTable() {
+    std::lock_guard<std::mutex> guard(reciprocityMutex);
+    reciprocityTable().clear();
+}
+
+size_t Reciprocity::tableSize() {
+    std::lock_guard<std::mutex> guard(reciprocityMutex);
+    return reciprocityTable().size();
 }
 
 void Reciprocity::search_reciprocity(
@@ -0,0 +1,402 @@
+#include "mutation_rules.h"
+#include <fstream>
+#include <sstream>
+
+namespace tpm {
+
+static const std::vector<std::pair<std::string, TransposeOp::TransType>>
+    transTypes = {
+        {"NoneType", TransposeOp::NoneType}, {"N2H", TransposeOp::N2H},
+        {"N2W", TransposeOp::N2W},           {"H2N", TransposeOp::H2N},
+        {"W2N", TransposeOp::W2N},           {"C2H", TransposeOp::C2H},
+        {"C2W", TransposeOp::C2W},           {"D2H", TransposeOp::D2H},
+        {"D2W", TransposeOp::D2W},
+};
+
+template <class T>
+static bool lookup(const std::vector<std::pair<std::string, T>> &table,
+                   const std::string &name, T &value) {
+    for (auto &kv : table)
+        if (kv.first == name) {
+            value = kv.second;
+            return true;
+        }
+    return false;
+}
+
+static int gcd(int a, int b) { return b == 0 ? a : gcd(b, a % b); }
+
+static bool parseInt(const std::string &str, int &value) {
+    char *end;
+    value = strtol(str.c_str(), &end, 10);
+    return !str.empty() && *end == '\0';
+}
+
+// "1,2,3"
+static bool parseList(const std::string &str, std::vector<int> &list) {
+    std::stringstream ss(str);
+    std::string item;
+    list.clear();
+    while (std::getline(ss, item, ',')) {
+        int value;
+        if (!parseInt(item, value))
+            return false;
+        list.emplace_back(value);
+    }
+    return !list.empty();
+}
+
+// "0,1,{-1,2},3"
+static bool parsePerm(const std::string &str, std::vector<PermItem> &perm) {
+    perm.clear();
+    for (size_t i = 0; i < str.size();) {
+        std::vector<int> items;
+        size_t end;
+        if (str[i] == '{') {
+            end = str.find('}', i);
+            if (end == std::string::npos ||
+                !parseList(str.substr(i + 1, end - i - 1), items))
+                return false;
+            end++;
+        } else {
+            end = std::min(str.find(',', i), str.size());
+            if (!parseList(str.substr(i, end - i), items))
+                return false;
+        }
+        perm.emplace_back(items);
+        if (end < str.size() && str[end] != ',')
+            return false;
+        i = end + 1;
+    }
+    return !perm.empty();
+}
+
+static bool parseOp(const std::vector<std::string> &args,
+                    std::function<Operator *(SubGraph *)> &op) {
+    auto &name = args[0];
+    std::vector<int> v;
+    for (size_t i = 1; i < args.size(); ++i) {
+        int x;
+        if (!parseInt(args[i], x))
+            break;
+        v.emplace_back(x);
+    }
+    if (name == "transpose") {
+        std::vector<PermItem> after;
+        int split, factor = 2;
+        if (args.size() < 3 || args.size() > 5 || !parseInt(args[1], split) ||
+            !parsePerm(args[2], after))
+            return false;
+        auto transType = TransposeOp::NoneType;
+        if (args.size() > 3 && !parseInt(args[3], factor))
+            return false;
+        if (args.size() > 4 && !lookup(transTypes, args[4], transType))
+            return false;
+        op = [=](SubGraph *) {
+            return new TransposeOp(split, after, factor, transType);
+        };
+    } else if (name == "conv") {
+        if (args.size() < 2)
+            return false;
+        if (args[1] == "inherit" || args[1] == "same" || args[1] == "valid") {
+            v.clear();
+            for (size_t i = 2; i < args.size(); ++i) {
+                int x;
+                if (!parseInt(args[i], x))
+                    return false;
+                v.emplace_back(x);
+            }
+            if (v.size() > 4)
+                return false;
+            auto mode = args[1];
+            v.resize(4, 1);
+            int sh = v[0], sw = v[1], dh = v[2], dw = v[3];
+            op = [=](SubGraph *sg) {
+                auto pm = mode == "same" ? ConvOp::Same : ConvOp::Valid;
+                if (mode == "inherit") {
+                    auto conv = dynamic_cast<ConvOp *>(sg->getOperators()[0]);
+                    pm = conv == nullptr ? ConvOp::Same
+                                         : conv->getPaddingMode();
+                }
+                return new ConvOp(pm, sh, sw, dh, dw);
+            };
+        } else {
+            if (v.size() != args.size() - 1 || v.size() < 2 || v.size() > 6)
+                return false;
+            v.resize(6, 1);
+            op = [=](SubGraph *) {
+                return new ConvOp(v[0], v[1], v[2], v[3], v[4], v[5]);
+            };
+        }
+    } else if (name == "matmul") {
+        if (args.size() != 3 || v.size() != 2)
+            return false;
+        op = [=](SubGraph *) { return new MatmulOp(v[0], v[1]); };
+    } else if (name == "pad" || name == "slice") {
+        std::vector<int> begin, end;
+        if (args.size() != 3 || !parseList(args[1], begin) ||
+            !parseList(args[2], end) || begin.size() != end.size())
+            return false;
+        if (name == "pad")
+            op = [=](SubGraph *) { return new PadOp(begin, end); };
+        else
+            op = [=](SubGraph *) { return new SliceOp(begin, end); };
+    } else if (name == "concat") {
+        if (args.size() != 2 || v.size() != 1)
+            return false;
+        op = [=](SubGraph *) { return new ConcatOp(v[0]); };
+    } else if (name == "split") {
+        std::vector<int> sizes;
+        if (args.size() != 3 || v.empty())
+            return false;
+        int dim = v[0];
+        if (args[2] == "gcd")
+            op = [=](SubGraph *sg) {
+                std::vector<int> sizes;
+                int g = 0;
+                for (auto cur : sg->getOperators()) {
+                    auto &dims = cur->getOutputs()[0]->getDims();
+                    sizes.emplace_back(dim < (int)dims.size() ? dims[dim] : 1);
+                    g = gcd(g, sizes.back());
+                }
+                for (auto &size : sizes)
+                    size /= std::max(g, 1);
+                return new SplitOp(dim, sizes);
+            };
+        else if (!parseList(args[2], sizes))
+            return false;
+        else if (args[2].find(',') == std::string::npos)
+            op = [=](SubGraph *) { return new SplitOp(dim, sizes[0]); };
+        else
+            op = [=](SubGraph *) { return new SplitOp(dim, sizes); };
+    } else if (name == "extend") {
+        if (args.size() != 3 || v.size() != 2)
+            return false;
+        op = [=](SubGraph *) { return new ExtendOp(v[0], v[1]); };
+    } else if (name == "clone") {
+        if (args.size() != 1)
+            return false;
+        op = [](SubGraph *sg) { return sg->getOperators()[0]->clone(); };
+    } else if (name == "identity") {
+        if (args.size() != 1)
+            return false;
+        op = [](SubGraph *) { return new IdentityOp(); };
+    } else
+        return false;
+    return true;
+}
+
+static bool validKey(const std::string &key) {
+    static const std::vector<std::string> keys = {
+        "ops", "ph", "pw", "sh", "sw", "dh", "dw", "transA", "transB"};
+    if (std::find(keys.begin(), keys.end(), key) != keys.end())
+        return true;
+    size_t prefix = key.compare(0, 2, "in") == 0    ? 2
+                    : key.compare(0, 3, "out") == 0 ? 3
+                                                    : 0;
+    auto dot = key.find('.');
+    int x;
+    return prefix > 0 && dot != std::string::npos &&
+           parseInt(key.substr(prefix, dot - prefix), x) &&
+           parseInt(key.substr(dot + 1), x);
+}
+
+bool MutationRules::Predicate::eval(SubGraph *sg) const {
+    auto &ops = sg->getOperators();
+    if (ops.empty())
+        return false;
+    auto op = ops[0];
+    int x;
+    if (key == "ops")
+        x = ops.size();
+    else if (key[0] == 'i' || key[0] == 'o') {
+        size_t prefix = key[0] == 'i' ? 2 : 3;
+        auto dot = key.find('.');
+        int t = atoi(key.substr(prefix, dot - prefix).c_str());
+        int d = atoi(key.substr(dot + 1).c_str());
+        auto &tensors = key[0] == 'i' ? op->getInputs() : op->getOutputs();
+        if (t >= (int)tensors.size() ||
+            d >= (int)tensors[t]->getDims().size())
+            return false;
+        x = tensors[t]->getDims()[d];
+    } else if (key == "transA" || key == "transB") {
+        auto matmul = dynamic_cast<MatmulOp *>(op);
+        if (matmul == nullptr)
+            return false;
+        x = key == "transA" ? matmul->getTransA() : matmul->getTransB();
+    } else {
+        auto conv = dynamic_cast<ConvOp *>(op);
+        if (conv == nullptr)
+            return false;
+        x = key == "ph"   ? conv->getPh()
+            : key == "pw" ? conv->getPw()
+            : key == "sh" ? conv->getSh()
+            : key == "sw" ? conv->getSw()
+            : key == "dh" ? conv->getDh()
+                          : conv->getDw();
+    }
+    if (mod > 0)
+        x %= mod;
+    if (cmp == "==")
+        return x == value;
+    if (cmp == "!=")
+        return x != value;
+    if (cmp == "<")
+        return x < value;
+    if (cmp == "<=")
+        return x <= value;
+    if (cmp == ">")
+        return x > value;
+    return x >= value;
+}
+
+bool MutationRules::Rule::applicable(SubGraph *sg) const {
+    for (auto &pred : when)
+        if (!pred.eval(sg))
+            return false;
+    return true;
+}
+
+int MutationRules::load(std::istream &is) {
+    static const std::vector<std::string> cmps = {"==", "!=", "<",
+                                                  "<=", ">",  ">="};
+    std::vector<Rule> loaded;
+    bool inRule = false;
+    std::string line;
+    for (int lineno = 1; std::getline(is, line); ++lineno) {
+        line = line.substr(0, line.find('#'));
+        std::stringstream ss(line);
+        std::vector<std::string> args;
+        std::string arg;
+        while (ss >> arg)
+            args.emplace_back(arg);
+        if (args.empty())
+            continue;
+        bool ok = true;
+        if (!inRule) {
+            // rule <name> <SGType> [depth <n>]
+            ok = args[0] == "rule" && (args.size() == 3 || args.size() == 5);
+            Rule rule;
+            rule.depth = 3;
+            rule.group = 0;
+            if (ok) {
+                rule.name = args[1];
+                ok = parseType(args[2], rule.type);
+            }
+            if (ok && args.size() == 5)
+                ok = args[3] == "depth" && parseInt(args[4], rule.depth) &&
+                     rule.depth > 0;
+            loaded.emplace_back(rule);
+            inRule = true;
+        } else if (args[0] == "end") {
+            ok = args.size() == 1;
+            inRule = false;
+        } else if (args[0] == "when") {
+            // when <key> [% <mod>] <cmp> <value>
+            Predicate pred;
+            pred.key = args.size() > 1 ? args[1] : "";
+            pred.mod = 0;
+            size_t i = 2;
+            if (args.size() == 6 && args[2] == "%") {
+                ok = parseInt(args[3], pred.mod) && pred.mod > 0;
+                i = 4;
+            }
+            ok = ok && args.size() == i + 2 && validKey(pred.key) &&
+                 std::find(cmps.begin(), cmps.end(), args[i]) != cmps.end() &&
+                 parseInt(args[i + 1], pred.value);
+            if (ok) {
+                pred.cmp = args[i];
+                loaded.back().when.emplace_back(pred);
+            }
+        } else if (args[0] == "op") {
+            std::function<Operator *(SubGraph *)> op;
+            ok = args.size() > 1 &&
+                 parseOp(std::vector<std::string>(args.begin() + 1,
+                                                  args.end()),
+                         op);
+            if (ok)
+                loaded.back().ops.emplace_back(op);
+        } else if (args[0] == "group") {
+            // group <n> | group ops
+            int n = -1;
+            ok = args.size() == 2 &&
+                 (args[1] == "ops" || (parseInt(args[1], n) && n > 1));
+            if (ok)
+                loaded.back().group = n;
+        } else if (args[0] == "preprocess") {
+            Preprocess pre;
+            ok = args.size() == 2 && parsePreprocess(args[1], pre);
+            if (ok)
+                loaded.back().preprocess.emplace_back(pre);
+        } else
+            ok = false;
+        if (!ok) {
+            std::cout << "[ERROR] mutation_rules::load: invalid line "
+                      << lineno << ": " << line << std::endl;
+            return 1;
+        }
+    }
+    if (inRule) {
+        std::cout << "[ERROR] mutation_rules::load: rule "
+                  << loaded.back().name << " is not ended" << std::endl;
+        return 1;
+    }
+    rules.insert(rules.end(), loaded.begin(), loaded.end());
+    return 0;
+}
+
+int MutationRules::loadFile(const std::string &file) {
+    std::ifstream fin(file);
+    if (!fin) {
+        std::cout << "[ERROR] mutation_rules::loadFile: cannot open " << file
+                  << std::endl;
+        return 1;
+    }
+    return load(fin);
+}
+
+bool MutationRules::hasRules(Generator::SGType type) const {
+    for (auto &rule : rules)
+        if (rule.type == type)
+            return true;
+    return false;
+}
+
+std::vector<const MutationRules::Rule *>
+MutationRules::match(Generator::SGType type, SubGraph *sg) const {
+    std::vector<const Rule *> ret;
+    for (auto &rule : rules)
+        if (rule.type == type && rule.applicable(sg))
+            ret.emplace_back(&rule);
+    return ret;
+}
+
+bool MutationRules::parsePreprocess(const std::string &str,
+                                    Preprocess &pre) {
+    static const std::vector<std::pair<std::string, Preprocess>> table = {
+        {"Conv1x1", &Generator::addPreprocessForConv1x1},
+        {"GroupConvGCD", &Generator::addPreprocessForGroupConvGCD},
+        {"GroupConvMAX", &Generator::addPreprocessForGroupConvMAX},
+        {"GroupConvOneInput", &Generator::addPreprocessForGroupConvOneInput},
+        {"PadSlice", &Generator::addPreprocessForPadSlice},
+        {"TransKernel", &Generator::addPreprocessForTransKernel},
+        {"BatchMatmul", &Generator::addPreprocessForBatchMatmul},
+        {"TransposeGroupConvRS",
+         &Generator::addPreprocessForTransposeGroupConvRS},
+        {"TransposeGroupConvSR",
+         &Generator::addPreprocessForTransposeGroupConvSR},
+    };
+    return lookup(table, str, pre);
+}
+
+bool MutationRules::parseType(const std::string &str,
+                              Generator::SGType &type) {
+    for (int i = Generator::Empty; i <= Generator::Others; ++i)
+        if (str == Generator::getTypeName(Generator::SGType(i))) {
+            type = Generator::SGType(i);
+            return true;
+        }
+    return false;
+}
+
+} // end of namespace tpm
@@ -0,0 +1,71 @@
+#include "op_pool.h"
+#include "serializer.h"
+#include <sstream>
+
+namespace tpm {
+
+bool OpPool::sameParams(Operator *a, Operator *b) {
+    if (a->getType() != b->getType() || a->getHash() != b->getHash())
+        return false;
+    // the hash is only 31 bits, so the attributes are compared in full
+    if (a->getType() == Operator::Conv) {
+        auto ca = dynamic_cast<ConvOp *>(a), cb = dynamic_cast<ConvOp *>(b);
+        // the padding of a Same or Valid conv is set by its input shape
+        auto mode = ca->getPaddingMode();
+        return mode == cb->getPaddingMode() &&
+               (mode != ConvOp::Other ||
+                (ca->getPh() == cb->getPh() && ca->getPw() == cb->getPw())) &&
+               ca->getSh() == cb->getSh() && ca->getSw() == cb->getSw() &&
+               ca->getDh() == cb->getDh() && ca->getDw() == cb->getDw() &&
+               ca->getAct() == cb->getAct() &&
+               (ca->getBias() == nullptr) == (cb->getBias() == nullptr);
+    }
+    std::ostringstream sa, sb;
+    if (Serializer::saveOpAttrs(sa, a) || Serializer::saveOpAttrs(sb, b))
+        return false;
+    return sa.str() == sb.str();
+}
+
+Operator *OpPool::acquire(Operator *proto) {
+    auto it = freeOps.find(proto->getHash());
+    if (it != freeOps.end()) {
+        auto &ops = it->second;
+        for (size_t i = ops.size(); i > 0; --i) {
+            auto op = ops[i - 1];
+            if (!sameParams(op, proto))
+                continue;
+            ops.erase(ops.begin() + (i - 1));
+            numFree--;
+            numReused++;
+            return op;
+        }
+    }
+    numCreated++;
+    auto op = proto->clone();
+    op->clear();
+    return op;
+}
+
+void OpPool::release(Operator *op) {
+    if (op == nullptr)
+        return;
+    op->clear();
+    freeOps[op->getHash()].emplace_back(op);
+    numFree++;
+}
+
+void OpPool::release(OpVec &ops) {
+    for (auto op : ops)
+        release(op);
+    ops.clear();
+}
+
+void OpPool::clear() {
+    for (auto &item : freeOps)
+        for (auto op : item.second)
+            delete op;
+    freeOps.clear();
+    numFree = 0;
+}
+
+} // end of namespace tpm
@@ -0,0 +1,155 @@
+#include "rule_stats.h"
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+
+namespace tpm {
+
+RuleStats::RuleStats() : minHitRate(0), minRuns(8), inPartition(false) {
+    auto env = getenv("PET_RULE_SKIP");
+    if (env != nullptr)
+        minHitRate = atof(env);
+    env = getenv("PET_RULE_STATS");
+    if (env != nullptr) {
+        path = env;
+        std::ifstream fin(path);
+        if (fin.good())
+            load(path);
+    }
+}
+
+RuleStats::~RuleStats() {
+    if (!path.empty() && !entries.empty())
+        save(path);
+}
+
+void RuleStats::beginPartition() {
+    std::lock_guard<std::mutex> guard(mtx);
+    inPartition = true;
+    partitionRuns.clear();
+}
+
+void RuleStats::endPartition() {
+    std::lock_guard<std::mutex> guard(mtx);
+    inPartition = false;
+    partitionRuns.clear();
+}
+
+void RuleStats::recordRun(const std::string &key, size_t mutants) {
+    std::lock_guard<std::mutex> guard(mtx);
+    auto &entry = entries[key];
+    if (!inPartition || partitionRuns.insert(key).second)
+        entry.runs++;
+    entry.mutants += mutants;
+}
+
+void RuleStats::recordHit(const std::string &key, double gain) {
+    std::lock_guard<std::mutex> guard(mtx);
+    auto &entry = entries[key];
+    entry.hits++;
+    entry.gain += gain;
+}
+
+bool RuleStats::shouldSkip(const std::string &key) {
+    if (minHitRate <= 0)
+        return false;
+    std::lock_guard<std::mutex> guard(mtx);
+    auto it = entries.find(key);
+    if (it == entries.end() || it->second.runs < minRuns)
+        return false;
+    return it->second.hits < minHitRate * it->second.runs;
+}
+
+RuleStats::Entry RuleStats::get(const std::string &key) {
+    std::lock_guard<std::mutex> guard(mtx);
+    auto it = entries.find(key);
+    return it == entries.end() ? Entry() : it->second;
+}
+
+std::map<std::string, RuleStats::Entry> RuleStats::getAll() {
+    std::lock_guard<std::mutex> guard(mtx);
+    return entries;
+}
+
+void RuleStats::clear() {
+    std::lock_guard<std::mutex> guard(mtx);
+    entries.clear();
+}
+
+void RuleStats::saveData(std::ostream &os) {
+    std::lock_guard<std::mutex> guard(mtx);
+    os << "rules " << entries.size() << "\n";
+    for (auto &kv : entries)
+        os << kv.first << " " << kv.second.runs << " " << kv.second.mutants
+           << " " << kv.second.hits << " " << kv.second.gain << "\n";
+}
+
+int RuleStats::loadData(std::istream &is) {
+    std::map<std::string, Entry> loaded;
+    if (parseData(is, loaded))
+        return 1;
+    mergeData(loaded);
+    return 0;
+}
+
+int RuleStats::parseData(std::istream &is,
+                         std::map<std::string, Entry> &data) {
+    std::string tag;
+    size_t n;
+    if (!(is >> tag >> n) || tag != "rules") {
+        std::cout << "[ERROR] RuleStats::parseData: corrupted rule stats."
+                  << std::endl;
+        return 1;
+    }
+    for (size_t i = 0; i < n; ++i) {
+        std::string key;
+        Entry entry;
+        if (!(is >> key >> entry.runs >> entry.mutants >> entry.hits >>
+              entry.gain)) {
+            std::cout << "[ERROR] RuleStats::parseData: corrupted rule stats."
+                      << std::endl;
+            return 1;
+        }
+        data[key] = entry;
+    }
+    return 0;
+}
+
+void RuleStats::mergeData(const std::map<std::string, Entry> &data) {
+    std::lock_guard<std::mutex> guard(mtx);
+    for (auto &kv : data)
+        entries[kv.first] = kv.second;
+}
+
+int RuleStats::save(const std::string &file) {
+    std::string tmpFile = file + ".tmp";
+    std::ofstream fout(tmpFile);
+    if (!fout) {
+        std::cout << "[ERROR] RuleStats::save: cannot open " << tmpFile
+                  << std::endl;
+        return 1;
+    }
+    fout << "PET_RULE_STATS 1\n";
+    saveData(fout);
+    fout.close();
+    if (!fout || std::rename(tmpFile.c_str(), file.c_str()) != 0) {
+        std::cout << "[ERROR] RuleStats::save: cannot write " << file
+                  << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+int RuleStats::load(const std::string &file) {
+    std::ifstream fin(file);
+    std::string tag;
+    int version;
+    if (!(fin >> tag >> version) || tag != "PET_RULE_STATS" || version != 1) {
+        std::cout << "[ERROR] RuleStats::load: invalid file " << file
+                  << std::endl;
+        return 1;
+    }
+    return loadData(fin);
+}
+
+} // end of namespace tpm
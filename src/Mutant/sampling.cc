@@ -0,0 +1,90 @@
+#include "sampling.h"
+#include <cstdlib>
+#include <random>
+#include <string>
+
+namespace tpm {
+
+SamplingPolicy SamplingPolicy::fromEnv() {
+    SamplingPolicy policy;
+    auto env = getenv("PET_SAMPLE_COUNT");
+    if (env != nullptr && atoi(env) > 0)
+        policy.count = atoi(env);
+    env = getenv("PET_SAMPLE_MODE");
+    if (env != nullptr) {
+        std::string mode = env;
+        if (mode == "stratified")
+            policy.mode = Stratified;
+        else if (mode == "boundary")
+            policy.mode = Boundary;
+        else if (mode != "grid")
+            std::cout << "[ERROR] SamplingPolicy::fromEnv: unknown mode "
+                      << mode << std::endl;
+    }
+    env = getenv("PET_SAMPLE_SEED");
+    if (env != nullptr)
+        policy.seed = strtoul(env, nullptr, 10);
+    env = getenv("PET_SAMPLE_MAX_MISMATCH");
+    if (env != nullptr)
+        policy.maxMismatches = std::max(atoi(env), 0);
+    return policy;
+}
+
+std::vector<Dim> SamplingPolicy::samplePoints(
+    const Dim &dims, size_t outputId, const SplittingPoints *splits) const {
+    std::mt19937 rng(hashAppend(seed, outputId));
+    auto uniform = [&rng](int lo, int hi) { // [lo, hi)
+        return hi <= lo ? lo : lo + (int)(rng() % (uint32_t)(hi - lo));
+    };
+    std::vector<Dim> points(count, Dim(dims.size()));
+    switch (mode) {
+    case Grid:
+        for (auto &point : points)
+            for (size_t j = 0, jEnd = dims.size(); j < jEnd; ++j)
+                point[j] = ((rng() % 2) + 1) * dims[j] / 3;
+        break;
+    case Stratified:
+        for (size_t j = 0, jEnd = dims.size(); j < jEnd; ++j) {
+            std::vector<int> strata(count);
+            for (int i = 0; i < count; ++i)
+                strata[i] = i;
+            std::shuffle(strata.begin(), strata.end(), rng);
+            for (int i = 0; i < count; ++i) {
+                int lo = (int64_t)strata[i] * dims[j] / count;
+                int hi = (int64_t)(strata[i] + 1) * dims[j] / count;
+                points[i][j] = std::min(uniform(lo, hi), dims[j] - 1);
+            }
+        }
+        break;
+    case Boundary: {
+        std::vector<std::vector<int>> special;
+        for (size_t j = 0, jEnd = dims.size(); j < jEnd; ++j) {
+            int d = dims[j];
+            special.push_back({0, d - 1, d / 2 - 1, d / 2});
+            // the last position before and the first after a split
+            if (splits != nullptr && j < splits->size())
+                for (auto p : (*splits)[j])
+                    if (p > 0 && p < d) {
+                        special[j].emplace_back(p - 1);
+                        special[j].emplace_back(p);
+                    }
+        }
+        for (auto &point : points)
+            for (size_t j = 0, jEnd = dims.size(); j < jEnd; ++j) {
+                auto &cand = special[j];
+                point[j] = rng() % 2 ? std::max(cand[rng() % cand.size()], 0)
+                                     : uniform(0, dims[j]);
+            }
+        break;
+    }
+    }
+    return points;
+}
+
+bool SamplingPolicy::shouldReject(int mismatches, float threshold) const {
+    if (maxMismatches > 0 && mismatches >= maxMismatches)
+        return true;
+    return float(count - mismatches) / count <= threshold;
+}
+
+} // end of namespace tpm
@@ -0,0 +1,98 @@
+#include "search_stats.h"
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace tpm {
+
+void SearchCounters::add(const SearchCounters &rhs) {
+    runs += rhs.runs;
+    nodes += rhs.nodes;
+    prunedVisited += rhs.prunedVisited;
+    prunedReciprocity += rhs.prunedReciprocity;
+    prunedSameOp += rhs.prunedSameOp;
+    prunedShape += rhs.prunedShape;
+    prunedDepth += rhs.prunedDepth;
+    verifications += rhs.verifications;
+    mutants += rhs.mutants;
+    skippedPasses += rhs.skippedPasses;
+    verifyTime += rhs.verifyTime;
+    runTime += rhs.runTime;
+}
+
+std::string SearchCounters::toJson() const {
+    std::ostringstream os;
+    os << "{\"runs\":" << runs << ",\"nodes\":" << nodes
+       << ",\"pruned\":{\"visited\":" << prunedVisited
+       << ",\"reciprocity\":" << prunedReciprocity
+       << ",\"same_op\":" << prunedSameOp << ",\"shape\":" << prunedShape
+       << ",\"depth\":" << prunedDepth
+       << "},\"verifications\":" << verifications
+       << ",\"verify_us\":" << verifyTime << ",\"mutants\":" << mutants
+       << ",\"skipped_passes\":" << skippedPasses
+       << ",\"run_us\":" << runTime << "}";
+    return os.str();
+}
+
+SearchStats::SearchStats() {
+    auto env = getenv("PET_SEARCH_STATS");
+    if (env != nullptr)
+        path = env;
+}
+
+SearchStats::~SearchStats() {
+    if (!path.empty() && !byType.empty())
+        dump(path);
+}
+
+void SearchStats::add(const std::string &type,
+                      const SearchCounters &counters) {
+    std::lock_guard<std::mutex> guard(mtx);
+    byType[type].add(counters);
+}
+
+std::map<std::string, SearchCounters> SearchStats::get() {
+    std::lock_guard<std::mutex> guard(mtx);
+    return byType;
+}
+
+SearchCounters SearchStats::getTotal() {
+    std::lock_guard<std::mutex> guard(mtx);
+    SearchCounters ret;
+    for (auto &item : byType)
+        ret.add(item.second);
+    return ret;
+}
+
+void SearchStats::clear() {
+    std::lock_guard<std::mutex> guard(mtx);
+    byType.clear();
+}
+
+std::string SearchStats::toJson() {
+    auto types = get();
+    SearchCounters total;
+    std::ostringstream os;
+    os << "{\"types\":{";
+    for (auto it = types.begin(); it != types.end(); ++it) {
+        os << (it == types.begin() ? "\n" : ",\n") << "\"" << it->first
+           << "\":" << it->second.toJson();
+        total.add(it->second);
+    }
+    os << "\n},\"total\":" << total.toJson() << "}\n";
+    return os.str();
+}
+
+int SearchStats::dump(const std::string &file) {
+    std::ofstream fout(file);
+    if (!fout) {
+        std::cout << "[ERROR] SearchStats::dump: cannot open " << file
+                  << std::endl;
+        return 1;
+    }
+    fout << toJson();
+    return 0;
+}
+
+} // end of namespace tpm
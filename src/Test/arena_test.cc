@@ -0,0 +1,36 @@
+#include "arena.h"
+#include "tensor.h"
+
+int main() {
+    tpm::TensorArena arena(1024);
+    tpm::Tensor a({4, 8}), b({16, 16, 16}), c({2, 3});
+    a.setAllocator(&arena);
+    b.setAllocator(&arena);
+    c.setAllocator(&arena);
+    a.dataMalloc();
+    b.dataMalloc(); // larger than a chunk
+    c.dataMalloc();
+    std::cout << "used " << arena.getUsed() << " peak " << arena.getPeak()
+              << " capacity " << arena.getCapacity() << std::endl;
+    if (arena.getUsed() != 32 + 4096 + 6)
+        return 1;
+    for (size_t i = 0; i < a.size(); ++i)
+        a.setData(i, i);
+    // b is released below the top and reclaimed together with c
+    b.clear();
+    if (arena.getUsed() != 32 + 6 || a.getData(31) != 31)
+        return 1;
+    c.clear();
+    c.setDims({8, 8});
+    c.dataMalloc();
+    std::cout << "used " << arena.getUsed() << " peak " << arena.getPeak()
+              << " capacity " << arena.getCapacity() << std::endl;
+    if (arena.getPeak() != 32 + 4096 + 6 || arena.getUsed() != 32 + 64)
+        return 1;
+    a.clear();
+    c.clear();
+    if (arena.getUsed() != 0)
+        return 1;
+    std::cout << "arena test passed" << std::endl;
+    return 0;
+}
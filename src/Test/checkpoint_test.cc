@@ -0,0 +1,124 @@
+#include "graph.h"
+#include "search_engine.h"
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <unordered_map>
+
+// Searches a model and saves a checkpoint, then resumes the search in a new
+// process, where tensor hashes of the first process belong to other tensors.
+
+static std::shared_ptr<tpm::SubGraph> buildGraph() {
+    auto g = new tpm::Graph();
+    auto i0 = g->tensor({1, 16, 14, 14});
+    auto w0 = g->tensor({16, 16, 3, 3});
+    auto c0 = g->conv(i0, w0, 1, 1);
+    auto w1 = g->tensor({16, 16, 3, 3});
+    g->conv(c0->getOutput(), w1, 1, 1);
+    g->updateConnection();
+    return std::make_shared<tpm::SubGraph>(g->getOperators());
+}
+
+// compute graph from the data of the tensors of src with the same hashes
+static bool compute(tpm::SubGraph *graph, tpm::SubGraph *src) {
+    std::unordered_map<uint64_t, tpm::Tensor *> data;
+    for (auto t : src->getInputs())
+        data[t->getHash()] = t;
+    for (auto t : graph->getInputs()) {
+        auto it = data.find(t->getHash());
+        if (it == data.end())
+            return false;
+        t->dataMalloc();
+        t->setData(it->second->getDataPtr());
+    }
+    // the ops are computed once their inputs are
+    for (size_t done = 0, last = -1; done != last;) {
+        last = done;
+        done = 0;
+        for (auto op : graph->getOperators()) {
+            auto ready = true;
+            for (auto t : op->getInputs())
+                ready = ready && t->isComputed();
+            if (ready && op->compute() != nullptr)
+                done++;
+        }
+    }
+    for (auto t : graph->getOutputs())
+        if (!t->isComputed())
+            return false;
+    return true;
+}
+
+static int countLines(const std::string &file, const std::string &text) {
+    std::ifstream fin(file);
+    std::string line;
+    int ret = 0;
+    while (std::getline(fin, line))
+        if (line.find(text) != std::string::npos)
+            ret++;
+    return ret;
+}
+
+static int resume(const std::string &file) {
+    // tensors of the first process had these hashes
+    std::vector<tpm::Tensor *> shift;
+    for (int i = 0; i < 100; ++i)
+        shift.emplace_back(new tpm::Tensor());
+    auto graph = buildGraph();
+    std::shared_ptr<tpm::SubGraph> best;
+    tpm::SearchEngine engine;
+    engine.setCheckpointFile(file);
+    if (engine.run(graph, best))
+        return 1;
+    for (auto t : graph->getInputs())
+        t->dataRand();
+    if (!compute(graph.get(), graph.get()) ||
+        !compute(best.get(), graph.get())) {
+        std::cout << "resumed graph is not connected to the inputs"
+                  << std::endl;
+        return 1;
+    }
+    auto out = graph->getOutputs()[0];
+    for (auto t : best->getOutputs()) {
+        if (t->getHash() != out->getHash())
+            continue;
+        for (size_t i = 0; i < out->size(); ++i) {
+            if (t->getData(i) != out->getData(i)) {
+                std::cout << "resumed graph computes other outputs"
+                          << std::endl;
+                return 1;
+            }
+        }
+        return 0;
+    }
+    std::cout << "resumed graph lost the output" << std::endl;
+    return 1;
+}
+
+int main(int argc, char **argv) {
+    std::string file = "checkpoint_test.ckpt", log = "checkpoint_test.log";
+    if (argc > 1)
+        return resume(file);
+    std::remove(file.c_str());
+    auto graph = buildGraph();
+    std::shared_ptr<tpm::SubGraph> best;
+    tpm::SearchEngine engine;
+    engine.setCheckpointFile(file);
+    if (engine.run(graph, best))
+        return 1;
+    auto cmd = std::string(argv[0]) + " resume > " + log;
+    auto err = system(cmd.c_str());
+    auto parts = countLines(log, "Partition: ");
+    auto restored = countLines(log, "Partition restored from checkpoint.");
+    std::remove(file.c_str());
+    std::remove(log.c_str());
+    if (err != 0)
+        return 1;
+    if (parts == 0 || restored != parts) {
+        std::cout << "restored " << restored << " of " << parts
+                  << " partitions" << std::endl;
+        return 1;
+    }
+    std::cout << "checkpoint test passed" << std::endl;
+    return 0;
+}
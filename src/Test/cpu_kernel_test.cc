@@ -0,0 +1,104 @@
+#include "cpu_kernel.h"
+#include "graph.h"
+#include "operator.h"
+#include "tensor.h"
+
+// large values so that the products wrap around
+static void fill(tpm::Tensor *t, uint32_t seed) {
+    t->dataMalloc();
+    for (size_t i = 0, iEnd = t->size(); i < iEnd; ++i) {
+        seed = seed * 1664525u + 1013904223u;
+        t->setData(i, seed);
+    }
+}
+
+static bool checkConv(tpm::Dim in, tpm::Dim wt, int ph, int pw, int sh, int sw,
+                      int dh, int dw) {
+    auto g = new tpm::Graph();
+    auto i0 = g->tensor(in);
+    auto w0 = g->tensor(wt);
+    auto op = g->conv(i0, w0, ph, pw, sh, sw, dh, dw);
+    auto o0 = op->getOutput();
+    fill(i0, 1);
+    fill(w0, 2);
+    op->compute();
+
+    int n = in[0], c = in[1], h = in[2], w = in[3];
+    int f = wt[0], cpg = wt[1], r = wt[2], s = wt[3], grp = c / cpg;
+    int oh = o0->getDims()[2], ow = o0->getDims()[3];
+    for (int nn = 0; nn < n; nn++)
+        for (int ff = 0; ff < f; ff++)
+            for (int hh = 0; hh < oh; hh++)
+                for (int ww = 0; ww < ow; ww++) {
+                    int gidx = ff / (f / grp);
+                    tpm::VType val = 0;
+                    for (int cc = 0; cc < cpg; cc++)
+                        for (int rr = 0; rr < r; rr++)
+                            for (int ss = 0; ss < s; ss++) {
+                                int posH = hh * sh + rr * dh - ph;
+                                int posW = ww * sw + ss * dw - pw;
+                                if (posH < 0 || posH >= h || posW < 0 ||
+                                    posW >= w)
+                                    continue;
+                                val += i0->getData(
+                                           {nn, cc + gidx * cpg, posH, posW}) *
+                                       w0->getData({ff, cc, rr, ss});
+                            }
+                    if (o0->getData({nn, ff, hh, ww}) != val) {
+                        std::cout << "conv mismatch at " << nn << "," << ff
+                                  << "," << hh << "," << ww << std::endl;
+                        delete g;
+                        return false;
+                    }
+                }
+    delete g;
+    return true;
+}
+
+static bool checkMatmul(int b, int m, int n, int k, bool transA, bool transB) {
+    auto g = new tpm::Graph();
+    auto A = g->tensor(transA ? tpm::Dim{b, k, m} : tpm::Dim{b, m, k});
+    auto B = g->tensor(transB ? tpm::Dim{b, n, k} : tpm::Dim{b, k, n});
+    auto op = g->matmul(A, B, transA, transB);
+    auto C = op->getOutput();
+    fill(A, 3);
+    fill(B, 4);
+    op->compute();
+    for (int bb = 0; bb < b; ++bb)
+        for (int mm = 0; mm < m; ++mm)
+            for (int nn = 0; nn < n; ++nn) {
+                tpm::VType val = 0;
+                for (int kk = 0; kk < k; ++kk)
+                    val += (transA ? A->getData({bb, kk, mm})
+                                   : A->getData({bb, mm, kk})) *
+                           (transB ? B->getData({bb, nn, kk})
+                                   : B->getData({bb, kk, nn}));
+                if (C->getData({bb, mm, nn}) != val) {
+                    std::cout << "matmul mismatch at " << bb << "," << mm
+                              << "," << nn << std::endl;
+                    delete g;
+                    return false;
+                }
+            }
+    delete g;
+    return true;
+}
+
+int main() {
+    std::cout << "cpu kernels: " << tpm::cpu::isaName() << std::endl;
+    bool ok = true;
+    ok &= checkConv({1, 16, 14, 14}, {16, 16, 3, 3}, 1, 1, 1, 1, 1, 1);
+    ok &= checkConv({2, 8, 15, 13}, {12, 8, 3, 3}, 1, 1, 2, 2, 1, 1);
+    ok &= checkConv({1, 8, 14, 14}, {8, 8, 3, 3}, 2, 2, 1, 1, 2, 2);
+    ok &= checkConv({2, 8, 9, 9}, {8, 2, 3, 1}, 1, 0, 1, 1, 1, 1);
+    ok &= checkConv({1, 4, 7, 7}, {8, 4, 1, 1}, 0, 0, 1, 1, 1, 1);
+    ok &= checkConv({1, 600, 8, 8}, {20, 600, 3, 3}, 1, 1, 1, 1, 1, 1);
+    ok &= checkMatmul(1, 33, 70, 300, false, false);
+    ok &= checkMatmul(3, 17, 9, 21, true, false);
+    ok &= checkMatmul(2, 5, 31, 12, false, true);
+    ok &= checkMatmul(4, 8, 8, 8, true, true);
+    if (!ok)
+        return 1;
+    std::cout << "cpu kernel test passed" << std::endl;
+    return 0;
+}
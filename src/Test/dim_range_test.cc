@@ -0,0 +1,59 @@
+#include "graph.h"
+
+static bool check(bool cond, const std::string &msg) {
+    if (!cond)
+        std::cout << msg << std::endl;
+    return cond;
+}
+
+int main() {
+    // evenly spaced points merge into a strided box
+    auto dr = tpm::DimRange::getEmpty();
+    for (int i = 0; i < 5; ++i)
+        dr = tpm::unionRange(dr, tpm::Dim{1, i * 3});
+    if (!check(dr.isBox() && dr.getStep(1) == 3 && dr.size() == 5 &&
+                   dr.getEnd() == tpm::Dim{1, 12},
+               "points are not merged into a strided box"))
+        return 1;
+    auto pos = dr.getBegin();
+    int n = 1;
+    while (dr.next(pos))
+        n++;
+    if (!check(n == 5 && pos == dr.getBegin(), "wrong walk of a strided box"))
+        return 1;
+
+    // others are kept in a list, or bounded once the list is too long
+    auto list = tpm::unionRange(tpm::Dim{0, 0}, tpm::Dim{3, 5});
+    list = tpm::unionRange(list, tpm::DimRange({6, 0}, {6, 3}));
+    if (!check(list.isBoxList() && list.getBoxes().size() == 3 &&
+                   list.size() == 6,
+               "boxes are not kept in a list"))
+        return 1;
+    auto bound = tpm::unionRange(list, tpm::Dim{9, 7}, 3);
+    if (!check(bound.isBox() && bound.getStep(0) == 3 &&
+                   bound.getBegin() == tpm::Dim{0, 0} &&
+                   bound.getEnd() == tpm::Dim{9, 7},
+               "wrong bound of a long list"))
+        return 1;
+
+    // clipping keeps the positions of the box
+    auto clip = tpm::clipRange({-3, 0}, {9, 0}, {8, 1}, {2, 1});
+    if (!check(clip.getBegin() == tpm::Dim{1, 0} &&
+                   clip.getEnd() == tpm::Dim{7, 0} && clip.size() == 4,
+               "wrong strided clip"))
+        return 1;
+
+    // a box through a transpose needs exactly as many input positions
+    auto i0 = new tpm::Tensor({1, 1, 8, 8});
+    auto trans = new tpm::TransposeOp(i0, 2, {0, 1, {-1, 2}, 3}, -2);
+    auto out = tpm::DimRange({0, 0, 0, 0}, {0, 0, 3, 0});
+    auto in = trans->compute(out).first[0];
+    if (!check(in.size() == out.size(), "input region of a transpose box is "
+                                        "not exact"))
+        return 1;
+    std::cout << "dim range test passed" << std::endl;
+    delete trans->getOutput();
+    delete trans;
+    delete i0;
+    return 0;
+}
@@ -0,0 +1,68 @@
+#include "graph.h"
+#include "operator.h"
+#include "tensor.h"
+
+static std::shared_ptr<tpm::SubGraph> buildGraph(int dilation, bool reverse) {
+    auto g = new tpm::Graph();
+    auto i0 = g->tensor({1, 64, 14, 14});
+    auto w0 = g->tensor({64, 64, 3, 3});
+    auto w1 = g->tensor({64, 64, 3, 3});
+    auto i1 = g->tensor({1, 64, 14, 14});
+    auto i2 = g->tensor({1, 64, 14, 14});
+    auto i3 = g->tensor({1, 64, 14, 14});
+    auto i4 = g->tensor({1, 64, 14, 14});
+    g->conv(i0, w0, i1, 1, 1);
+    g->conv(i0, w1, i2, dilation, dilation, 1, 1, dilation, dilation);
+    g->add({i1, i2}, i3);
+    g->relu(i3, i4);
+    g->updateConnection();
+    tpm::OpVec ops = g->getOperators();
+    if (reverse)
+        std::swap(ops[0], ops[1]);
+    return std::make_shared<tpm::SubGraph>(ops);
+}
+
+// add(x, x) or add(x, y), and two convs sharing a weight or not
+static uint64_t sharingHash(bool shareAdd, bool shareWeight) {
+    auto g = new tpm::Graph();
+    auto x = g->tensor({1, 64, 14, 14});
+    auto y = shareAdd ? x : g->tensor({1, 64, 14, 14});
+    auto w0 = g->tensor({64, 64, 3, 3});
+    auto w1 = shareWeight ? w0 : g->tensor({64, 64, 3, 3});
+    auto a = g->add({x, y})->getOutput();
+    g->conv(a, w0, 1, 1);
+    g->conv(x, w1, 1, 1);
+    g->updateConnection();
+    auto ret = tpm::SubGraph(g->getOperators()).getCanonicalHash();
+    delete g;
+    return ret;
+}
+
+int main() {
+    auto a = buildGraph(1, false);
+    auto b = buildGraph(1, true);
+    auto c = buildGraph(2, false);
+    // fresh tensors give fresh tensor hashes
+    if (a->getHash() == b->getHash()) {
+        std::cout << "graphs on different tensors have equal hashes"
+                  << std::endl;
+        return 1;
+    }
+    if (a->getCanonicalHash() != b->getCanonicalHash()) {
+        std::cout << "canonical hash depends on op order or tensors"
+                  << std::endl;
+        return 1;
+    }
+    if (a->getCanonicalHash() == c->getCanonicalHash()) {
+        std::cout << "canonical hash ignores op attributes" << std::endl;
+        return 1;
+    }
+    if (sharingHash(true, false) == sharingHash(false, false) ||
+        sharingHash(false, true) == sharingHash(false, false) ||
+        sharingHash(true, true) == sharingHash(true, false)) {
+        std::cout << "canonical hash ignores shared inputs" << std::endl;
+        return 1;
+    }
+    std::cout << "graph hash test passed" << std::endl;
+    return 0;
+}
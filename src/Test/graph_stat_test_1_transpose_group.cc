@@ -19,7 +19,7 @@ int main() {
     auto op1 = g.conv(i1, w1, 3, 0);
 
     auto sg = SubGraph({op0, op1});
-    auto gen = Generator();
+    Generator gen;
     std::cout << gen.statGraph(&sg) << std::endl;
 
     return 0;
@@ -24,7 +24,7 @@ int main() {
     auto op2 = g->matmul(i0, w2, i3);
 
     auto sg = SubGraph({op0, op1});
-    auto gen = Generator();
+    Generator gen;
     std::cout << gen.statGraph(&sg) << std::endl;
 
     sg = SubGraph({op0, op2});
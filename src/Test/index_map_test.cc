@@ -0,0 +1,79 @@
+#include "graph.h"
+#include "index_map.h"
+
+// check the index map against the data computed by the transposes, where
+// the input holds its own linear index
+static bool matchData(tpm::Tensor *output, const tpm::IndexMap &map) {
+    auto digits = map.canonical();
+    for (size_t i = 0; i < output->size(); ++i) {
+        size_t rem = i;
+        int64_t idx = 0;
+        for (int j = (int)digits.size() - 1; j >= 0; --j) {
+            idx += (rem % digits[j].radix) * digits[j].stride;
+            rem /= digits[j].radix;
+        }
+        if (output->getData(i) != (tpm::VType)idx)
+            return false;
+    }
+    return true;
+}
+
+int main() {
+    auto g = new tpm::Graph();
+    auto i0 = g->tensor({1, 1, 6, 6});
+    auto i1 = g->tensor({1, 1, 6, 6});
+    auto i2 = g->tensor({1, 1, 6, 6});
+    auto i3 = g->tensor({1, 1, 6, 6});
+    auto i4 = g->tensor({1, 1, 6, 6});
+    auto i5 = g->tensor({1, 1, 6, 6});
+    // (3, 2) x 6 -> 3 x 12, which keeps the data in place
+    g->transpose(i0, i1, 2, {0, 1, 2, {-1, 3}}, 2);
+    // 3 x (2, 6) -> (2, 3) x 6
+    g->transpose(i1, i2, 3, {0, 1, {3, 2}, -1}, -2);
+    // (2, 3) x 6 -> 3 x (2, 6) undoes the last transpose
+    g->transpose(i2, i3, 2, {0, 1, -1, {2, 3}}, -2);
+    // (2, 3) x 6 -> 3 x 2 x 6 moves the same data to other dims
+    g->transpose(i2, i4, 2, {0, {1, -1}, 2, 3}, -2);
+    // splitting (2, 3) into (3, 2) mixes the digits
+    g->transpose(i2, i5, 2, {0, 1, 2, -1, 3}, 2);
+    g->updateConnection();
+
+    i0->dataMalloc();
+    for (size_t i = 0; i < i0->size(); ++i)
+        i0->setData(i, i);
+    for (auto op : g->getOperators())
+        op->compute();
+
+    for (auto op : g->getOperators()) {
+        auto trans = (tpm::TransposeOp *)op;
+        if (trans->inferShape(op->getInputs()[0]->getDims()) !=
+            op->getOutput()->getDims()) {
+            std::cout << "wrong shape inferred" << std::endl;
+            return 1;
+        }
+    }
+
+    tpm::IndexMap m0(i0), m[6];
+    for (int i = 1; i < 5; ++i) {
+        auto t = g->getTensors()[i];
+        if (!tpm::IndexMap::fromTensor(t, m[i])) {
+            std::cout << "transpose chain is not symbolic" << std::endl;
+            return 1;
+        }
+        if (m[i].getDims() != t->getDims() || !matchData(t, m[i])) {
+            std::cout << "index map does not match the data" << std::endl;
+            return 1;
+        }
+    }
+    if (tpm::IndexMap::fromTensor(i5, m[5])) {
+        std::cout << "mixed digits are not symbolic" << std::endl;
+        return 1;
+    }
+    if (m[3] != m[1] || m[2] == m[1] || m[2] == m[4] || m[1] == m0) {
+        std::cout << "wrong reciprocity" << std::endl;
+        return 1;
+    }
+    std::cout << "index map test passed" << std::endl;
+    delete g;
+    return 0;
+}
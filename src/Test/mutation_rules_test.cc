@@ -0,0 +1,179 @@
+#include "graph.h"
+#include "mutation_rules.h"
+#include <algorithm>
+#include <cstdlib>
+#include <set>
+#include <sstream>
+
+int main() {
+    std::stringstream ss;
+    ss << "rule c2h NormalConv depth 3\n"
+          "  when in0.1 % 2 == 0  # channels can be halved\n"
+          "  op transpose 1 0,1,{2,-1},3 2 C2H\n"
+          "  op conv inherit 2 1 1 1\n"
+          "end\n"
+          "rule big_batch NormalConv\n"
+          "  when in0.0 >= 16\n"
+          "  op transpose 0 0,1,{-1,2},3 2 N2H\n"
+          "end\n";
+    tpm::MutationRules rules;
+    if (rules.load(ss) || rules.size() != 2) {
+        std::cout << "cannot load rules" << std::endl;
+        return 1;
+    }
+    std::stringstream bad("rule x NormalConv\n  op transpose 1 0,1,{2,-1\nend\n");
+    if (rules.load(bad) == 0 || rules.size() != 2) {
+        std::cout << "invalid rule is loaded" << std::endl;
+        return 1;
+    }
+
+    auto g = new tpm::Graph();
+    auto i0 = g->tensor({1, 64, 14, 14});
+    auto w0 = g->tensor({64, 64, 3, 3});
+    g->conv(i0, w0, tpm::ConvOp::Same);
+    g->updateConnection();
+    auto sg = new tpm::SubGraph(g->getOperators());
+    tpm::Generator mutant;
+    auto type = mutant.statGraph(sg);
+    auto matched = rules.match(type, sg);
+    if (type != tpm::Generator::NormalConv || matched.size() != 1 ||
+        matched[0]->name != "c2h" || matched[0]->ops.size() != 2) {
+        std::cout << "wrong rules matched" << std::endl;
+        return 1;
+    }
+    auto conv = matched[0]->ops[1](sg);
+    if (conv->getType() != tpm::Operator::Conv ||
+        ((tpm::ConvOp *)conv)->getPaddingMode() != tpm::ConvOp::Same) {
+        std::cout << "wrong op compiled" << std::endl;
+        return 1;
+    }
+    delete conv;
+
+    // the rules replace the built-in candidates of the graph type
+    mutant.setMutationRules(std::make_shared<tpm::MutationRules>(rules));
+    std::vector<tpm::SubGraph *> candidates;
+    mutant.run(sg, candidates);
+    std::cout << "candidates found: " << candidates.size() << std::endl;
+    for (auto candidate : candidates)
+        for (auto op : candidate->getOperators())
+            if (op->isTransposeOp() &&
+                ((tpm::TransposeOp *)op)->getType() != tpm::TransposeOp::C2H) {
+                std::cout << "candidate uses ops of other rules" << std::endl;
+                return 1;
+            }
+
+    // the loaded candidates of a NormalConv keep the split group mutants
+    auto g1 = new tpm::Graph();
+    auto i1 = g1->tensor({1, 64, 4, 4});
+    auto w1 = g1->tensor({64, 16, 3, 3});
+    g1->conv(i1, w1, tpm::ConvOp::Same);
+    g1->updateConnection();
+    auto sg1 = new tpm::SubGraph(g1->getOperators());
+    candidates.clear();
+    // the split group mutants take more ops than the default depth
+    setenv("PET_MUTATION_DEPTH", "5", 1);
+    mutant.run(sg1, candidates, 5);
+    unsetenv("PET_MUTATION_DEPTH");
+    auto &mutantRules = mutant.getMutantRules();
+    if (mutant.statGraph(sg1) != tpm::Generator::NormalConv ||
+        std::none_of(mutantRules.begin(), mutantRules.end(),
+                     [](const std::string &key) {
+                         return key.find(".SplitGroup@") != std::string::npos;
+                     })) {
+        std::cout << "split group mutants are missing" << std::endl;
+        return 1;
+    }
+
+    // graphs no rule matches get the built-in candidates
+    auto g3 = new tpm::Graph();
+    auto i3 = g3->tensor({1, 3, 8, 8});
+    auto w3 = g3->tensor({3, 3, 3, 3});
+    g3->conv(i3, w3, tpm::ConvOp::Same);
+    g3->updateConnection();
+    auto sg3 = new tpm::SubGraph(g3->getOperators());
+    candidates.clear();
+    mutant.run(sg3, candidates);
+    if (mutant.statGraph(sg3) != tpm::Generator::NormalConv ||
+        !rules.match(tpm::Generator::NormalConv, sg3).empty() ||
+        candidates.empty()) {
+        std::cout << "unmatched graph has no candidates" << std::endl;
+        return 1;
+    }
+
+    // the group and split parameters give the mutants of the built-in
+    // GroupConv candidates
+    auto g4 = new tpm::Graph();
+    auto i4 = g4->tensor({1, 16, 8, 8});
+    g4->conv(i4, g4->tensor({4, 16, 3, 3}), 1, 1);
+    g4->conv(i4, g4->tensor({6, 16, 3, 3}), 1, 1);
+    g4->conv(i4, g4->tensor({8, 16, 3, 3}), 1, 1);
+    g4->updateConnection();
+    auto sg4 = new tpm::SubGraph(g4->getOperators());
+    std::stringstream group("rule group_conv GroupConv depth 4\n"
+                            "  group ops\n"
+                            "  op clone\n"
+                            "  op concat 0\n"
+                            "  op concat 1\n"
+                            "  op split 1 gcd\n"
+                            "  preprocess GroupConvGCD\n"
+                            "  preprocess GroupConvMAX\n"
+                            "end\n");
+    auto groupRules = std::make_shared<tpm::MutationRules>();
+    if (groupRules->load(group)) {
+        std::cout << "cannot load group rules" << std::endl;
+        return 1;
+    }
+    auto groupRule = groupRules->match(tpm::Generator::GroupConv, sg4);
+    auto split = (tpm::SplitOp *)groupRule[0]->ops[3](sg4);
+    if (groupRule[0]->group != -1 ||
+        split->getSizes() != std::vector<int>{2, 3, 4}) {
+        std::cout << "wrong group or split sizes" << std::endl;
+        return 1;
+    }
+    delete split;
+    std::vector<tpm::SubGraph *> builtin, loaded;
+    tpm::Generator builtinGen, loadedGen;
+    loadedGen.setMutationRules(groupRules);
+    // the preprocessed graphs extend the inputs to the gcd of the groups
+    setenv("PET_MUTATION_DEPTH", "8", 1);
+    builtinGen.run(sg4, builtin, 8);
+    loadedGen.run(sg4, loaded, 8);
+    unsetenv("PET_MUTATION_DEPTH");
+    std::set<uint64_t> builtinHashes, loadedHashes;
+    for (auto candidate : builtin)
+        builtinHashes.insert(candidate->getCanonicalHash());
+    for (auto candidate : loaded)
+        loadedHashes.insert(candidate->getCanonicalHash());
+    if (builtinGen.statGraph(sg4) != tpm::Generator::GroupConv ||
+        builtinHashes.empty() || builtinHashes != loadedHashes) {
+        std::cout << "group rules found " << loaded.size()
+                  << " candidates, the built-in ones " << builtin.size()
+                  << std::endl;
+        return 1;
+    }
+
+    // and are turned off with the built-in candidates of their graph type
+    setenv("PET_DISABLE_NO_NEQ_OPT", "1", 1);
+    std::stringstream dilated("rule d DilatedConv\n"
+                              "  op conv inherit 1 1 1 1\n"
+                              "end\n");
+    auto dilatedRules = std::make_shared<tpm::MutationRules>();
+    dilatedRules->load(dilated);
+    tpm::Generator eqOnly;
+    eqOnly.setMutationRules(dilatedRules);
+    auto g2 = new tpm::Graph();
+    auto i2 = g2->tensor({1, 64, 14, 14});
+    auto w2 = g2->tensor({64, 64, 3, 3});
+    g2->conv(i2, w2, 2, 2, 1, 1, 2, 2);
+    g2->updateConnection();
+    auto sg2 = new tpm::SubGraph(g2->getOperators());
+    candidates.clear();
+    eqOnly.run(sg2, candidates);
+    if (eqOnly.statGraph(sg2) != tpm::Generator::DilatedConv ||
+        !candidates.empty()) {
+        std::cout << "disabled candidates are searched" << std::endl;
+        return 1;
+    }
+    std::cout << "mutation rules test passed" << std::endl;
+    return 0;
+}
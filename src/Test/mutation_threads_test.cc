@@ -0,0 +1,56 @@
+#include "graph.h"
+#include "mutation_rules.h"
+#include "search_engine.h"
+#include <cstdlib>
+#include <set>
+#include <sstream>
+
+// The pipeline threads of a search find the same mutants as a single thread,
+// also when the generator of the search is not configured by the environment.
+
+static int search(const char *threads, std::set<uint64_t> &mutants) {
+    setenv("PET_MUTATION_THREADS", threads, 1);
+    tpm::SearchEngine engine;
+    std::stringstream ss("rule c2h NormalConv depth 3\n"
+                         "  op transpose 1 0,1,{2,-1},3 2 C2H\n"
+                         "  op conv inherit 2 1 1 1\n"
+                         "end\n");
+    auto rules = std::make_shared<tpm::MutationRules>();
+    if (rules->load(ss))
+        return 1;
+    engine.exportMutationEngine()->setMutationRules(rules);
+
+    // one root per thread at least
+    std::vector<tpm::SearchEngine::Candidate> q;
+    std::vector<int> f;
+    for (int i = 0; i < 8; ++i) {
+        auto g = new tpm::Graph();
+        auto i0 = g->tensor({1, 16, 8 + 2 * i, 8 + 2 * i});
+        auto w0 = g->tensor({16, 16, 3, 3});
+        g->conv(i0, w0, 1, 1);
+        g->updateConnection();
+        q.emplace_back(std::make_shared<tpm::SubGraph>(g->getOperators()), 0);
+        f.emplace_back(0);
+    }
+    std::unordered_set<uint64_t> mutationSet;
+    if (engine.searchMutationBfs(mutationSet, q, f))
+        return 1;
+    mutants.insert(mutationSet.begin(), mutationSet.end());
+    return 0;
+}
+
+int main() {
+    setenv("PET_MUTATION_ROUND", "1", 1);
+    std::set<uint64_t> single, multi;
+    if (search("1", single) || search("4", multi)) {
+        std::cout << "search failed" << std::endl;
+        return 1;
+    }
+    if (single.empty() || single != multi) {
+        std::cout << "1 thread found " << single.size() << " mutants, 4 found "
+                  << multi.size() << std::endl;
+        return 1;
+    }
+    std::cout << "mutation threads test passed" << std::endl;
+    return 0;
+}
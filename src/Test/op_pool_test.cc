@@ -0,0 +1,60 @@
+#include "generator.h"
+
+static tpm::SubGraph *convGraph(tpm::Graph *g, int hw) {
+    auto i0 = g->tensor({1, 16, hw, hw});
+    auto w0 = g->tensor({16, 16, 3, 3});
+    auto op = g->conv(i0, w0, 1, 1);
+    return new tpm::SubGraph({op});
+}
+
+int main() {
+    auto g = new tpm::Graph();
+    auto graph0 = convGraph(g, 14);
+    auto graph1 = convGraph(g, 28);
+    g->updateConnection();
+
+    // the second run takes its candidate ops from the first one
+    tpm::Generator mutant;
+    std::vector<tpm::SubGraph *> out0, out1;
+    mutant.run(graph0, out0);
+    auto created = mutant.getOpPool().getCreated();
+    mutant.run(graph1, out1);
+    auto &pool = mutant.getOpPool();
+    if (created == 0 || pool.getReused() == 0 ||
+        pool.getCreated() != created) {
+        std::cout << "candidate ops are not recycled, created "
+                  << pool.getCreated() << " reused " << pool.getReused()
+                  << std::endl;
+        return 1;
+    }
+
+    // recycled ops find the same mutants as fresh ones
+    tpm::Generator fresh;
+    std::vector<tpm::SubGraph *> ref;
+    fresh.run(graph1, ref);
+    if (ref.size() != out1.size()) {
+        std::cout << "found " << out1.size() << " mutants with recycled ops, "
+                  << ref.size() << " with fresh ones" << std::endl;
+        return 1;
+    }
+    // ops whose hashes collide are not mixed up
+    tpm::OpPool ops;
+    tpm::ConvOp same(tpm::ConvOp::Same), valid(tpm::ConvOp::Valid);
+    valid.setHash(same.getHash());
+    ops.release(ops.acquire(&same));
+    auto op = ops.acquire(&valid);
+    if (ops.getReused() != 0 ||
+        ((tpm::ConvOp *)op)->getPaddingMode() != tpm::ConvOp::Valid) {
+        std::cout << "op with other attributes is reused" << std::endl;
+        return 1;
+    }
+    delete op;
+    std::cout << "op pool test passed" << std::endl;
+    for (auto outs : {out0, out1, ref})
+        for (auto sg : outs)
+            delete sg;
+    delete graph0;
+    delete graph1;
+    delete g;
+    return 0;
+}
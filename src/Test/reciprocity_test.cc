@@ -0,0 +1,45 @@
+#include "generator.h"
+#include "operator.h"
+
+int main() {
+    std::vector<std::shared_ptr<tpm::Operator>> ops;
+    ops.emplace_back(new tpm::TransposeOp(0, {0, 1, {-1, 2}, 3}, 2));
+    ops.emplace_back(new tpm::TransposeOp(2, {{0, 2}, 1, -1, 3}, -2));
+    ops.emplace_back(new tpm::TransposeOp(0, {0, 1, 2, {-1, 3}}, 2));
+    ops.emplace_back(new tpm::TransposeOp(3, {{0, 3}, 1, 2, -1}, -2));
+
+    tpm::Reciprocity::clearTable();
+    tpm::Reciprocity searched(ops);
+    if (searched.reciprocal_op_chains.empty() ||
+        tpm::Reciprocity::tableSize() != 1) {
+        std::cout << "no reciprocity found" << std::endl;
+        return 1;
+    }
+    // the order of the candidates does not matter
+    std::reverse(ops.begin(), ops.end());
+    tpm::Reciprocity cached(ops);
+    if (tpm::Reciprocity::tableSize() != 1 ||
+        cached.reciprocal_op_chains != searched.reciprocal_op_chains) {
+        std::cout << "reciprocity table is not reused" << std::endl;
+        return 1;
+    }
+
+    std::string file = "reciprocity_test.txt";
+    if (tpm::Reciprocity::saveTable(file))
+        return 1;
+    tpm::Reciprocity::clearTable();
+    if (tpm::Reciprocity::loadTable(file) ||
+        tpm::Reciprocity::tableSize() != 1) {
+        std::cout << "cannot load reciprocity table" << std::endl;
+        return 1;
+    }
+    std::remove(file.c_str());
+    tpm::Reciprocity loaded(ops);
+    if (tpm::Reciprocity::tableSize() != 1 ||
+        loaded.reciprocal_op_chains != searched.reciprocal_op_chains) {
+        std::cout << "loaded reciprocity table differs" << std::endl;
+        return 1;
+    }
+    std::cout << "reciprocity test passed" << std::endl;
+    return 0;
+}
@@ -0,0 +1,115 @@
+#include "generator.h"
+#include "rule_stats.h"
+#include <cstdio>
+
+int main() {
+    auto &stats = tpm::RuleStats::getInstance();
+    stats.clear();
+    stats.setSkipping(0);
+
+    auto g = new tpm::Graph();
+    auto i0 = g->tensor({1, 16, 14, 14});
+    auto w0 = g->tensor({16, 16, 3, 3});
+    g->conv(i0, w0, 1, 1);
+    g->updateConnection();
+    auto graph = new tpm::SubGraph(g->getOperators());
+
+    std::vector<tpm::SubGraph *> out_graphs;
+    tpm::Generator mutant;
+    mutant.run(graph, out_graphs);
+    auto &rules = mutant.getMutantRules();
+    if (out_graphs.empty() || rules.size() != out_graphs.size()) {
+        std::cout << "mutants are not labelled with their rules" << std::endl;
+        return 1;
+    }
+    std::string dfs = "NormalConv.Dfs@3x3";
+    auto entry = stats.get(dfs);
+    if (entry.runs != 1 || entry.mutants == 0 ||
+        entry.mutants + stats.get("NormalConv.SplitGroup@3x3").mutants !=
+            out_graphs.size()) {
+        std::cout << "wrong runs of " << dfs << std::endl;
+        return 1;
+    }
+
+    // an equal conv hits the mutation cache and gets the mutants with their
+    // rules, reading its own tensors
+    auto i1 = g->tensor({1, 16, 14, 14});
+    auto w1 = g->tensor({16, 16, 3, 3});
+    auto graph1 = new tpm::SubGraph({g->conv(i1, w1, 1, 1)});
+    auto firstRules = rules;
+    std::vector<tpm::SubGraph *> cached;
+    mutant.run(graph1, cached);
+    if (cached.size() != out_graphs.size() || rules != firstRules ||
+        stats.get(dfs).runs != 1) {
+        std::cout << "cached mutants lost their rules" << std::endl;
+        return 1;
+    }
+    for (auto sg : cached) {
+        auto bound = sg->getOutputs()[0]->getHash() ==
+                     graph1->getOutputs()[0]->getHash();
+        for (auto t : sg->getInputs())
+            bound = bound && (t->getHash() == i1->getHash() ||
+                              t->getHash() == w1->getHash());
+        if (!bound) {
+            std::cout << "cached mutant is not bound to the graph" << std::endl;
+            return 1;
+        }
+        delete sg;
+    }
+
+    // the history survives a save and load
+    stats.recordHit(dfs, 0.5);
+    if (stats.save("rule_stats_test.txt"))
+        return 1;
+    stats.clear();
+    if (stats.load("rule_stats_test.txt") || stats.get(dfs).hits != 1 ||
+        stats.get(dfs).gain != 0.5 || stats.get(dfs).runs != 1)
+        return 1;
+    std::remove("rule_stats_test.txt");
+
+    // a pass without hits is skipped, one with enough hits still runs
+    stats.setSkipping(0.5, 1);
+    if (stats.shouldSkip(dfs) ||
+        !stats.shouldSkip("NormalConv.SplitGroup@3x3")) {
+        std::cout << "wrong passes skipped" << std::endl;
+        return 1;
+    }
+    for (int i = 0; i < 3; ++i)
+        stats.recordRun(dfs, 0);
+    std::vector<tpm::SubGraph *> skipped;
+    tpm::Generator other;
+    other.run(graph, skipped);
+    if (!stats.shouldSkip(dfs) || !skipped.empty() ||
+        other.getSearchCounters().skippedPasses != 2) {
+        std::cout << "unproductive passes are not skipped" << std::endl;
+        return 1;
+    }
+
+    // the runs of a pass in a partition count once, like its hits, so a
+    // pass winning every partition is not skipped
+    stats.clear();
+    for (int p = 0; p < 3; ++p) {
+        stats.beginPartition();
+        for (int i = 0; i < 3; ++i) {
+            std::vector<tpm::SubGraph *> mutants;
+            tpm::Generator gen;
+            gen.run(graph, mutants);
+            for (auto sg : mutants)
+                delete sg;
+        }
+        stats.endPartition();
+        stats.recordHit(dfs, 1);
+    }
+    if (stats.get(dfs).runs != 3 || stats.shouldSkip(dfs)) {
+        std::cout << "a winning pass is skipped" << std::endl;
+        return 1;
+    }
+    stats.setSkipping(0);
+
+    std::cout << "rule stats test passed" << std::endl;
+    for (auto sg : out_graphs)
+        delete sg;
+    delete graph;
+    delete g;
+    return 0;
+}
@@ -0,0 +1,77 @@
+#include "sampling.h"
+
+int main() {
+    tpm::Dim dims = {2, 16, 14, 14};
+    for (auto mode : {tpm::SamplingPolicy::Grid,
+                      tpm::SamplingPolicy::Stratified,
+                      tpm::SamplingPolicy::Boundary}) {
+        tpm::SamplingPolicy policy(8, mode, 42);
+        auto points = policy.samplePoints(dims);
+        auto again = policy.samplePoints(dims);
+        if (points != again || points.size() != 8) {
+            std::cout << "mode " << mode << " sampled " << points.size()
+                      << " points, expected 8";
+            for (size_t i = 0; i < points.size() && i < again.size(); ++i)
+                if (points[i] != again[i])
+                    std::cout << ", point " << i << " differs between runs";
+            std::cout << std::endl;
+            return 1;
+        }
+        for (auto &point : points)
+            for (size_t i = 0; i < dims.size(); ++i)
+                if (point[i] < 0 || point[i] >= dims[i]) {
+                    std::cout << "mode " << mode << " sampled " << point[i]
+                              << " in dim " << i << " of size " << dims[i]
+                              << std::endl;
+                    return 1;
+                }
+    }
+
+    // one point per stratum of every dim
+    tpm::SamplingPolicy stratified(7, tpm::SamplingPolicy::Stratified, 1);
+    auto points = stratified.samplePoints({14, 14});
+    for (size_t d = 0; d < 2; ++d) {
+        std::vector<int> hit(7, 0);
+        for (auto &point : points)
+            hit[point[d] / 2]++;
+        for (size_t i = 0; i < hit.size(); ++i)
+            if (hit[i] != 1) {
+                std::cout << "stratified sampling hit stratum " << i
+                          << " of dim " << d << " " << hit[i]
+                          << " times, expected 1" << std::endl;
+                return 1;
+            }
+    }
+
+    // boundary sampling hits both sides of a splitting point, which uniform
+    // sampling of 1000 positions would rarely do
+    tpm::SamplingPolicy boundary(64, tpm::SamplingPolicy::Boundary, 3);
+    tpm::SplittingPoints splits = {{}, {301}};
+    std::vector<int> hit(1000, 0);
+    for (auto &point : boundary.samplePoints({4, 1000}, 0, &splits))
+        hit[point[1]]++;
+    if (hit[300] == 0 || hit[301] == 0) {
+        std::cout << "boundary sampling hit 300 and 301 " << hit[300]
+                  << " and " << hit[301] << " times around the split at 301"
+                  << std::endl;
+        return 1;
+    }
+
+    // 8 points at threshold 0.7 need 6 matches, so 3 mismatches reject
+    tpm::SamplingPolicy policy(8);
+    if (policy.shouldReject(2, 0.7) || !policy.shouldReject(3, 0.7)) {
+        std::cout << "8 points at threshold 0.7 rejected 2 mismatches "
+                  << policy.shouldReject(2, 0.7) << " and 3 mismatches "
+                  << policy.shouldReject(3, 0.7) << ", expected 0 and 1"
+                  << std::endl;
+        return 1;
+    }
+    policy.maxMismatches = 1;
+    if (!policy.shouldReject(1, 0.7)) {
+        std::cout << "1 mismatch not rejected with maxMismatches 1"
+                  << std::endl;
+        return 1;
+    }
+    std::cout << "sampling test passed" << std::endl;
+    return 0;
+}
@@ -0,0 +1,54 @@
+#include "generator.h"
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+int main() {
+    auto g = new tpm::Graph();
+    auto i0 = g->tensor({1, 16, 14, 14});
+    auto w0 = g->tensor({16, 16, 3, 3});
+    g->conv(i0, w0, 1, 1);
+    g->updateConnection();
+    auto graph = new tpm::SubGraph(g->getOperators());
+
+    tpm::SearchStats::getInstance().clear();
+    tpm::Generator mutant;
+    std::vector<tpm::SubGraph *> out_graphs;
+    mutant.run(graph, out_graphs);
+
+    auto &counters = mutant.getSearchCounters();
+    if (counters.runs != 1 || counters.nodes == 0 ||
+        counters.verifications == 0 ||
+        counters.mutants != out_graphs.size()) {
+        std::cout << "wrong counters of the run" << std::endl;
+        return 1;
+    }
+    // the reciprocity search of the generator is reported on its own
+    auto types = tpm::SearchStats::getInstance().get();
+    auto type = tpm::Generator::getTypeName(mutant.statGraph(graph));
+    if (types.count(type) == 0 || types[type].nodes != counters.nodes ||
+        types[type].mutants != counters.mutants) {
+        std::cout << "counters not added to the stats" << std::endl;
+        return 1;
+    }
+
+    std::string file = "search_stats_test.json";
+    if (tpm::SearchStats::getInstance().dump(file))
+        return 1;
+    std::ifstream fin(file);
+    std::stringstream ss;
+    ss << fin.rdbuf();
+    fin.close();
+    std::remove(file.c_str());
+    if (ss.str().find("\"" + std::string(type) + "\":{\"runs\":1,") ==
+        std::string::npos) {
+        std::cout << "wrong report " << ss.str() << std::endl;
+        return 1;
+    }
+    std::cout << "search stats test passed" << std::endl;
+    for (auto sg : out_graphs)
+        delete sg;
+    delete graph;
+    delete g;
+    return 0;
+}
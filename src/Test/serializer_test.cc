@@ -0,0 +1,105 @@
+#include "graph.h"
+#include "operator.h"
+#include "search_engine.h"
+#include "serializer.h"
+#include "tensor.h"
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <unordered_map>
+
+static std::string readFile(const std::string &file) {
+    std::ifstream fin(file);
+    std::stringstream ss;
+    ss << fin.rdbuf();
+    return ss.str();
+}
+
+static void writeFile(const std::string &file, const std::string &text) {
+    std::ofstream fout(file);
+    fout << text;
+}
+
+int main() {
+    auto g = new tpm::Graph();
+    auto i0 = g->tensor({1, 64, 14, 14});
+    auto w0 = g->tensor({64, 64, 3, 3});
+    auto w1 = g->tensor({64, 64, 1, 1});
+    auto i1 = g->tensor({1, 64, 14, 14});
+    auto i2 = g->tensor({1, 64, 14, 14});
+    auto i3 = g->tensor({1, 64, 14, 14});
+    g->conv(i0, w0, i1, 1, 1);
+    g->relu(i1, i2);
+    g->conv(i2, w1, i3, 0, 0);
+    auto i4 = g->tensor({2, 64, 7, 14});
+    g->transpose(i3, i4, 2, {{0, -1}, 1, 2, 3}, 2);
+    g->split(i4, 1, 2);
+    g->updateConnection();
+
+    auto graph = std::make_shared<tpm::SubGraph>(g->getOperators());
+    std::stringstream ss;
+    tpm::Serializer::saveGraph(ss, graph.get());
+    auto loaded = tpm::Serializer::loadGraph(ss);
+    if (loaded == nullptr) {
+        std::cout << "load failed" << std::endl;
+        return 1;
+    }
+    // loaded tensors get fresh hashes, the structure stays the same
+    for (auto t : loaded->getTensors()) {
+        for (auto u : graph->getTensors()) {
+            if (t->getHash() == u->getHash()) {
+                std::cout << "loaded tensor kept its saved hash" << std::endl;
+                return 1;
+            }
+        }
+    }
+    if (graph->getCanonicalHash() != loaded->getCanonicalHash()) {
+        std::cout << "graph changed after loading" << std::endl;
+        return 1;
+    }
+    // bound to the saved hashes, it is saved as the same text
+    std::unordered_map<uint64_t, uint64_t> bind;
+    for (auto t : graph->getTensors())
+        bind[t->getHash()] = t->getHash();
+    std::stringstream reload(ss.str()), resaved;
+    auto bound = tpm::Serializer::loadGraph(reload, bind);
+    tpm::Serializer::saveGraph(resaved, bound.get());
+    if (resaved.str() != ss.str() || graph->getHash() != bound->getHash()) {
+        std::cout << "bound graph changed after loading" << std::endl;
+        return 1;
+    }
+
+    // a checkpoint with an archive and a finished partition round trips
+    std::stringstream io, ck;
+    io << graph->getInputs().size();
+    for (auto t : graph->getInputs())
+        io << " " << t->getHash();
+    io << " " << graph->getOutputs().size();
+    for (auto t : graph->getOutputs())
+        io << " " << t->getHash();
+    ck << "PET_CHECKPOINT 2\nend\narchive 1\n"
+       << graph->getCanonicalHash() << " " << io.str() << " 2\n"
+       << ss.str() << ss.str() << "parts 1\n"
+       << graph->getCanonicalHash() << " 0 " << io.str() << " 1\n"
+       << ss.str() << "rules 0\n";
+    std::string file = "serializer_test.ckpt";
+    writeFile(file, ck.str());
+    tpm::SearchEngine engine;
+    if (engine.loadCheckpoint(file) || engine.saveCheckpoint(file) ||
+        readFile(file) != ck.str()) {
+        std::cout << "checkpoint changed after loading" << std::endl;
+        return 1;
+    }
+    // a truncated checkpoint leaves the engine empty
+    writeFile(file, ck.str().substr(0, ck.str().find("parts") + 8));
+    tpm::SearchEngine fresh;
+    if (fresh.loadCheckpoint(file) == 0 || fresh.saveCheckpoint(file) ||
+        readFile(file) != "PET_CHECKPOINT 2\nend\narchive 0\nparts 0\n"
+                          "rules 0\n") {
+        std::cout << "truncated checkpoint was partly loaded" << std::endl;
+        return 1;
+    }
+    std::remove(file.c_str());
+    std::cout << "serializer test passed" << std::endl;
+    return 0;
+}
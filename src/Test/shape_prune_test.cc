@@ -0,0 +1,70 @@
+#include "generator.h"
+#include "graph.h"
+#include "operator.h"
+
+// Branches whose shapes cannot reach the output of the searched graph are cut
+// before their output tensors are allocated.
+
+static int search(tpm::SubGraph *graph,
+                  std::vector<std::shared_ptr<tpm::Operator>> ops, int depth,
+                  size_t &pruned, size_t &mutants) {
+    tpm::Generator mutant;
+    std::vector<tpm::SubGraph *> out_graphs;
+    mutant.run(graph, out_graphs, depth, ops);
+    pruned = mutant.getSearchCounters().prunedShape;
+    mutants = out_graphs.size();
+    auto &dims = graph->getOutputs()[0]->getDims();
+    int ret = 0;
+    for (auto sg : out_graphs) {
+        if (sg->getOutputs().size() != 1 ||
+            sg->getOutputs()[0]->getDims() != dims)
+            ret = 1;
+        delete sg;
+    }
+    return ret;
+}
+
+int main() {
+    auto g = new tpm::Graph();
+    auto i0 = g->tensor({2, 4, 6, 8});
+    g->transpose(i0, -1, {0, 2, 3, 1});
+    g->updateConnection();
+    auto graph = new tpm::SubGraph(g->getOperators());
+
+    // {0, 1, 3, 2} gives {2, 4, 8, 6}, which is not the output at depth 1
+    size_t pruned, mutants;
+    if (search(graph,
+               {std::make_shared<tpm::TransposeOp>(-1,
+                                                   tpm::Perm({0, 2, 3, 1})),
+                std::make_shared<tpm::TransposeOp>(-1,
+                                                   tpm::Perm({0, 1, 3, 2}))},
+               1, pruned, mutants)) {
+        std::cout << "mutant with a wrong output shape" << std::endl;
+        return 1;
+    }
+    if (pruned != 1) {
+        std::cout << "transpose to {2, 4, 8, 6} pruned " << pruned
+                  << " times, expected 1" << std::endl;
+        return 1;
+    }
+
+    // 2 + 3 divides neither dim 1 of the input nor of its transpose
+    if (search(graph,
+               {std::make_shared<tpm::SplitOp>(1, std::vector<int>{2, 3}),
+                std::make_shared<tpm::TransposeOp>(-1,
+                                                   tpm::Perm({0, 2, 3, 1}))},
+               2, pruned, mutants)) {
+        std::cout << "mutant with a wrong output shape" << std::endl;
+        return 1;
+    }
+    // the split of the input at both depths and of the transpose at depth 1
+    if (pruned < 3) {
+        std::cout << "indivisible splits pruned " << pruned
+                  << " times, expected 3" << std::endl;
+        return 1;
+    }
+    std::cout << "shape prune test passed" << std::endl;
+    delete graph;
+    delete g;
+    return 0;
+}
@@ -0,0 +1,66 @@
+#include "graph.h"
+
+// id of the box holding pos in each dim, between the splitting points
+static std::vector<int> boxOf(tpm::Tensor *t, const tpm::Dim &pos) {
+    std::vector<int> ret;
+    auto &points = *t->getSplittingPoints();
+    for (size_t i = 0; i < pos.size(); ++i)
+        ret.emplace_back(std::upper_bound(points[i].begin(), points[i].end(),
+                                          pos[i]) -
+                         points[i].begin());
+    return ret;
+}
+
+// every box of the output holds data from a single box of the input
+static bool uniformBoxes(tpm::Tensor *output) {
+    std::map<std::vector<int>, tpm::VType> boxValue;
+    for (output->itInit(); output->itValid(); output->itNext()) {
+        auto &pos = output->itGet();
+        auto box = boxOf(output, pos);
+        auto it = boxValue.find(box);
+        if (it == boxValue.end())
+            boxValue[box] = output->getData(pos);
+        else if (it->second != output->getData(pos))
+            return false;
+    }
+    return true;
+}
+
+int main() {
+    auto g = new tpm::Graph();
+    auto i0 = g->tensor({1, 1, 6, 6});
+    auto i1 = g->tensor({1, 1, 6, 6});
+    auto i2 = g->tensor({1, 1, 6, 6});
+    auto i3 = g->tensor({1, 1, 6, 6});
+    g->transpose(i0, i1, 2, {0, 1, 2, {-1, 3}}, 2);
+    g->transpose(i1, i2, 3, {0, 1, {3, 2}, -1}, -2);
+    g->transpose(i2, i3, 2, {0, {1, -1}, 2, 3}, -2);
+    auto pad = g->pad(i0, {0, 0, 1, 1}, {0, 0, 1, 1});
+    g->updateConnection();
+
+    // the input holds the id of its box
+    i0->dataMalloc();
+    i0->setSplittingPoints({{}, {}, {1, 5}, {3}});
+    for (i0->itInit(); i0->itValid(); i0->itNext()) {
+        auto box = boxOf(i0, i0->itGet());
+        i0->setData(i0->itGet(), box[2] * 2 + box[3]);
+    }
+    for (auto op : g->getOperators()) {
+        op->compute();
+        op->inferSplittingPoints();
+    }
+
+    for (auto t : {i1, i2, i3}) {
+        if (!t->hasSplittingPoints() || !uniformBoxes(t)) {
+            std::cout << "boxes of a transpose are not uniform" << std::endl;
+            return 1;
+        }
+    }
+    if (pad->getOutput()->hasSplittingPoints()) {
+        std::cout << "pad should leave its output without points" << std::endl;
+        return 1;
+    }
+    std::cout << "splitting points test passed" << std::endl;
+    delete g;
+    return 0;
+}
@@ -0,0 +1,155 @@
+#include "graph.h"
+#include "strided_loop.h"
+
+using namespace tpm;
+
+// the offsets of all positions, visited in [begin, end) chunks
+static std::vector<std::vector<size_t>>
+walk(const StridedLoop &loop, size_t nOperands, size_t chunk) {
+    std::vector<std::vector<size_t>> ret;
+    for (size_t begin = 0; begin < loop.size(); begin += chunk) {
+        loop.forRange(begin, begin + chunk, [&](const size_t *off, size_t n) {
+            for (size_t j = 0; j < n; ++j) {
+                ret.emplace_back();
+                for (size_t k = 0; k < nOperands; ++k)
+                    ret.back().emplace_back(off[k] +
+                                            j * loop.getInnerStride(k));
+            }
+        });
+    }
+    return ret;
+}
+
+static void fill(Tensor *t) {
+    t->dataMalloc();
+    for (size_t i = 0, iEnd = t->size(); i < iEnd; ++i)
+        t->setData(i, (VType)(i * 7 % 13));
+    t->setComputed();
+}
+
+// batchnorm of an input of dims against the formula, one channel each
+static bool batchnormMatches(const Dim &dims) {
+    auto g = new Graph();
+    auto i0 = g->tensor(dims);
+    auto scale = g->tensor({dims[1]}), bias = g->tensor({dims[1]});
+    auto mean = g->tensor({dims[1]}), var = g->tensor({dims[1]});
+    auto b0 = g->batchnorm(i0, scale, bias, mean, var)->getOutput();
+    g->updateConnection();
+    for (auto t : {i0, scale, bias, mean, var})
+        fill(t);
+    for (int cc = 0; cc < dims[1]; ++cc) {
+        mean->setData(cc, 0);
+        bias->setData(cc, 100 * cc);
+    }
+    b0->getOutputOf()->compute();
+    auto ret = true;
+    for (i0->itInit(); i0->itValid(); i0->itNext()) {
+        auto &pos = i0->itGet();
+        int cc = pos[1];
+        double v = scale->getData(cc) / sqrt(var->getData(cc) + 1e-05f);
+        if (b0->getData(pos) != (VType)(i0->getData(pos) * v + 100 * cc))
+            ret = false;
+    }
+    delete g;
+    return ret;
+}
+
+int main() {
+    Dim dims = {3, 1, 4, 5};
+    std::vector<Dim> strides = {denseStrides(dims), {50, 7, 10, 2},
+                                {0, 1, 0, 0}};
+    StridedLoop loop(dims, strides);
+    std::vector<std::vector<size_t>> ref;
+    for (size_t i = 0; i < 60; ++i) {
+        auto pos = cntToIdx(dims, i);
+        ref.emplace_back();
+        for (auto &s : strides) {
+            size_t off = 0;
+            for (size_t d = 0; d < dims.size(); ++d)
+                off += (size_t)pos[d] * s[d];
+            ref.back().emplace_back(off);
+        }
+    }
+    for (size_t chunk : {1, 3, 7, 20, 60}) {
+        if (walk(loop, 3, chunk) != ref) {
+            std::cout << "wrong offsets in chunks of " << chunk << std::endl;
+            return 1;
+        }
+    }
+    // the last two dims are merged, the first is not
+    if (loop.getRunSize() != 20 || loop.getInnerStride(1) != 2) {
+        std::cout << "dims are not merged" << std::endl;
+        return 1;
+    }
+    std::atomic<size_t> sum(0);
+    StridedLoop big({64, 1024}, {{1024, 1}});
+    big.parallelFor([&](const size_t *off, size_t n) {
+        size_t local = 0;
+        for (size_t j = 0; j < n; ++j)
+            local += off[0] + j;
+        sum += local;
+    });
+    if (sum != (size_t)65536 * 65535 / 2) {
+        std::cout << "parallel loop missed positions" << std::endl;
+        return 1;
+    }
+
+    // kernels on the loop match the formulas, reading a view in place
+    auto g = new Graph();
+    auto i0 = g->tensor({2, 4, 6, 6});
+    auto v0 = g->slice(i0, {0, 0, 1, 0}, {0, 0, 1, 2})->getOutput();
+    auto t0 = g->transpose(v0, 2, {0, 1, {-1, 3}, 2}, 2)->getOutput();
+    // the same transpose of a copy of the view
+    auto i1 = g->tensor({2, 4, 4, 4});
+    auto t1 = g->transpose(i1, 2, {0, 1, {-1, 3}, 2}, 2)->getOutput();
+    auto c0 = g->tensor({4, 4});
+    auto scale = g->tensor({4}), bias = g->tensor({4});
+    auto mean = g->tensor({4}), var = g->tensor({4});
+    auto b0 = g->batchnorm(v0, scale, bias, mean, var)->getOutput();
+    auto a0 = g->add({v0, c0})->getOutput();
+    auto m0 = g->mul({v0, c0})->getOutput();
+    g->updateConnection();
+    for (auto t : {i0, c0, scale, bias, mean, var})
+        fill(t);
+    // VType is unsigned
+    for (int cc = 0; cc < 4; ++cc)
+        mean->setData(cc, 0);
+    v0->getOutputOf()->compute();
+    fill(i1);
+    for (size_t i = 0; i < i1->size(); ++i)
+        i1->setData(i, v0->getData(i));
+    for (auto op : g->getOperators())
+        op->compute();
+    if (!v0->isView()) {
+        std::cout << "slice output should be a view" << std::endl;
+        return 1;
+    }
+    for (v0->itInit(); v0->itValid(); v0->itNext()) {
+        auto &pos = v0->itGet();
+        auto x = v0->getData(pos), y = c0->getData({pos[2], pos[3]});
+        int cc = pos[1];
+        double v = scale->getData(cc) / sqrt(var->getData(cc) + 1e-05f);
+        VType bn = x * v + bias->getData(cc);
+        if (b0->getData(pos) != bn || a0->getData(pos) != x + y ||
+            m0->getData(pos) != x * y ||
+            t0->getData(pos) != t1->getData(pos)) {
+            std::cout << "wrong element at " << dimToString(pos) << std::endl;
+            return 1;
+        }
+    }
+    if (!v0->isView()) {
+        std::cout << "kernels should not materialize the view" << std::endl;
+        return 1;
+    }
+    // the channels are merged into one run when the dims after them are 1
+    for (auto dims : {Dim{1, 4, 1, 1}, Dim{2, 4, 1, 1}, Dim{2, 4, 1, 3}}) {
+        if (!batchnormMatches(dims)) {
+            std::cout << "wrong batchnorm of " << dimToString(dims)
+                      << std::endl;
+            return 1;
+        }
+    }
+    std::cout << "strided loop test passed" << std::endl;
+    delete g;
+    return 0;
+}
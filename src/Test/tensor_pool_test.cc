@@ -0,0 +1,69 @@
+#include "graph.h"
+
+int main() {
+    if (tpm::TensorPool::sizeClass(1) != 64 ||
+        tpm::TensorPool::sizeClass(257) != 320 ||
+        tpm::TensorPool::sizeClass(4096) != 4096 ||
+        tpm::TensorPool::sizeClass(4097) != 5120) {
+        std::cout << "wrong size classes" << std::endl;
+        return 1;
+    }
+
+    // released buffers are reused for the tensors of the same class
+    tpm::TensorPool pool(1 << 20);
+    tpm::Tensor a({3, 5}), b({4, 4});
+    a.setAllocator(&pool);
+    b.setAllocator(&pool);
+    a.dataMalloc();
+    auto ptr = a.getDataPtr();
+    if ((uintptr_t)ptr % 64 != 0) {
+        std::cout << "buffer is not aligned" << std::endl;
+        return 1;
+    }
+    a.dataFree();
+    b.dataMalloc();
+    auto stats = pool.getStats();
+    if (b.getDataPtr() != ptr || stats.hits != 1 || stats.used != 64 ||
+        stats.cached != 0) {
+        std::cout << "buffer is not reused" << std::endl;
+        return 1;
+    }
+    // buffers beyond the cache limit are freed
+    tpm::Tensor c(tpm::Dim{1 << 19});
+    c.setAllocator(&pool);
+    c.dataMalloc();
+    c.dataFree();
+    b.dataFree();
+    stats = pool.getStats();
+    if (stats.cached != 64 || stats.used != 0 || stats.peak != (2 << 20) + 64) {
+        std::cout << "wrong cache of the pool" << std::endl;
+        return 1;
+    }
+
+    // a graph releases the data of its tensors together
+    auto &defaultPool = tpm::TensorPool::getDefault();
+    auto used = defaultPool.getStats().used;
+    auto releases = defaultPool.getStats().releases;
+    auto g = new tpm::Graph();
+    auto i0 = g->tensor({1, 4, 6, 6});
+    auto w0 = g->tensor({4, 4, 3, 3});
+    auto conv = g->conv(i0, w0, 1, 1);
+    i0->dataRand();
+    w0->dataRand();
+    auto o0 = conv->compute();
+    if (defaultPool.getStats().used <= used) {
+        std::cout << "graph data does not come from the default pool"
+                  << std::endl;
+        return 1;
+    }
+    g->dataFree();
+    if (defaultPool.getStats().used != used ||
+        defaultPool.getStats().releases != releases + 3 ||
+        o0->getDataPtr() != nullptr) {
+        std::cout << "graph data is not released" << std::endl;
+        return 1;
+    }
+    delete g;
+    std::cout << "tensor pool test passed" << std::endl;
+    return 0;
+}
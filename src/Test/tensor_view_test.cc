@@ -0,0 +1,117 @@
+#include "graph.h"
+#include "operator.h"
+
+using namespace tpm;
+
+// the value of t at pos of a tensor holding its flat offsets
+static VType offsetOf(const Dim &dims, const Dim &pos) {
+    VType ret = 0;
+    for (size_t i = 0; i < dims.size(); ++i)
+        ret = ret * dims[i] + pos[i];
+    return ret;
+}
+
+static bool check(Tensor *t, const Dim &srcDims, const Dim &begin) {
+    for (t->itInit(); t->itValid(); t->itNext()) {
+        auto &pos = t->itGet();
+        if (t->getData(pos) != offsetOf(srcDims, elementwiseAdd(pos, begin)))
+            return false;
+    }
+    return true;
+}
+
+int main() {
+    auto g = new Graph();
+    Dim dims = {2, 4, 6, 6};
+    auto i0 = g->tensor(dims);
+    auto slice = g->slice(i0, {0, 1, 1, 0}, {0, 0, 1, 2});
+    auto s0 = slice->getOutput();
+    auto split = (SplitOp *)g->split(s0, 1, 3);
+    auto identity = g->identity(s0);
+    auto r0 = g->tensor({2, 16});
+    g->reshape(split->getOutputs()[1], r0);
+    // dim 0 parts of the input are contiguous
+    auto split0 = (SplitOp *)g->split(i0, 0, 2);
+    auto r1 = g->tensor({4, 36});
+    g->reshape(split0->getOutputs()[1], r1);
+    // a pure permutation of the slice
+    auto trans = g->transpose(s0, -1, {0, 2, 3, 1});
+    g->updateConnection();
+
+    i0->dataMalloc();
+    for (size_t i = 0; i < i0->size(); ++i)
+        i0->setData(i, i);
+    i0->setComputed();
+    for (auto op : g->getOperators()) {
+        if (op->isSplitOp())
+            ((SplitOp *)op)->computeV();
+        else
+            op->compute();
+    }
+
+    auto id0 = identity->getOutput();
+    if (!s0->isView() || !id0->isView() || id0->getViewBase() != i0 ||
+        !check(s0, dims, {0, 1, 1, 0}) || !check(id0, dims, {0, 1, 1, 0})) {
+        std::cout << "slice and identity should read the input" << std::endl;
+        return 1;
+    }
+    for (int i = 0; i < 3; ++i) {
+        auto part = split->getOutputs()[i];
+        if (!part->isView() || !check(part, dims, {0, 1 + i, 1, 0})) {
+            std::cout << "split part " << i << " is not a view" << std::endl;
+            return 1;
+        }
+    }
+    // a strided part cannot be reshaped in place
+    auto part1 = split->getOutputs()[1];
+    if (r0->isView() || !part1->isView()) {
+        std::cout << "reshape of a strided view should copy" << std::endl;
+        return 1;
+    }
+    for (size_t i = 0; i < r0->size(); ++i) {
+        if (r0->getData(i) != part1->getData(i)) {
+            std::cout << "reshape copied wrong data" << std::endl;
+            return 1;
+        }
+    }
+    if (!r1->isView() || r1->getData(0) != 144 || r1->getData(143) != 287) {
+        std::cout << "reshape of a dense view should be a view" << std::endl;
+        return 1;
+    }
+
+    auto t0 = trans->getOutput();
+    if (!t0->isView() || t0->getViewBase() != i0) {
+        std::cout << "permuting transpose should be a view" << std::endl;
+        return 1;
+    }
+    for (t0->itInit(); t0->itValid(); t0->itNext()) {
+        auto &pos = t0->itGet();
+        Dim from = {pos[0], pos[3] + 1, pos[1] + 1, pos[2]};
+        if (t0->getData(pos) != offsetOf(dims, from)) {
+            std::cout << "transpose view reads wrong data" << std::endl;
+            return 1;
+        }
+    }
+
+    // the base keeps its data while views read it
+    i0->dataFree();
+    if (i0->getDataPtr() == nullptr || !check(s0, dims, {0, 1, 1, 0})) {
+        std::cout << "base with views should not be freed" << std::endl;
+        return 1;
+    }
+
+    // writing a view gives it its own copy of the data
+    auto ptr = s0->getDataPtr();
+    if (s0->isView() || ptr[0] != offsetOf(dims, {0, 1, 1, 0})) {
+        std::cout << "materialized view has wrong data" << std::endl;
+        return 1;
+    }
+    id0->setData(0, -1);
+    if (id0->isView() || i0->getData(42) != 42 || id0->getData(1) != 43) {
+        std::cout << "writing a view should not change its base" << std::endl;
+        return 1;
+    }
+    std::cout << "tensor view test passed" << std::endl;
+    delete g;
+    return 0;
+}